@@ -0,0 +1,248 @@
+//
+//  anytime.cpp
+//  opencv
+//
+
+#include "anytime.h"
+
+static hough_budget budget = { ANYTIME_BUDGET_MS / 1000, 0 };
+
+void set_hough_budget(double ms, long points)
+{
+    budget.seconds = ms / 1000;
+    budget.points = points;
+}
+
+const hough_budget *get_hough_budget()
+{
+    return &budget;
+}
+
+bool parse_hough_budget(const char *spec)
+{
+    double ms = 0;
+    long points = 0;
+    int n = sscanf(spec, "%lf,%ld", &ms, &points);
+    if (n < 1 || ms < 0 || points < 0 || (ms == 0 && points == 0))
+        return false;
+    set_hough_budget(ms, points);
+    return true;
+}
+
+// ------------------------
+
+const int NUM_ANGLES = 180;                 // theta resolution: 1 degree
+const int SHIFT = 16;                       // fixed-point fraction bits of the line walk
+
+// mask values
+const uchar NOT_EDGE = 0;
+const uchar UNVOTED = 1;                    // edge point that hasn't voted yet
+const uchar VOTED = 2;
+
+// adds delta to the point's bin at every angle; returns the highest count among them
+//  and its angle (best_n)
+static int vote(Mat &accum, const float *trig, int numrho, int x, int y, int delta, int *best_n)
+{
+    int *acc = accum.ptr<int>();
+    int best = 0;
+    for (int n = 0; n < NUM_ANGLES; n++, acc += numrho) {
+        int r = cvRound(x * trig[2*n] + y * trig[2*n + 1]) + (numrho - 1) / 2;
+        acc[r] += delta;
+        if (acc[r] > best) {
+            best = acc[r];
+            *best_n = n;
+        }
+    }
+    return best;
+}
+
+// walks the line through p at angle n both ways over the edge mask, one px at a time along
+// its main axis (bridging gaps up to max_gap), takes its points out (and their votes back),
+// and keeps it if it is at least min_length long
+static void take_line(hough_buffers *buf, const float *trig, int numrho, Point p, int n,
+                      int min_length, int max_gap, vector<Vec4i> *lines)
+{
+    int width = buf->mask.cols, height = buf->mask.rows;
+    float a = -trig[2*n + 1], b = trig[2*n];
+    bool xflag = abs(a) > abs(b);
+    int x0 = p.x, y0 = p.y, dx0, dy0;
+    if (xflag) {
+        dx0 = a > 0 ? 1 : -1;
+        dy0 = cvRound(b * (1 << SHIFT) / abs(a));
+        y0 = (y0 << SHIFT) + (1 << (SHIFT - 1));
+    }
+    else {
+        dy0 = b > 0 ? 1 : -1;
+        dx0 = cvRound(a * (1 << SHIFT) / abs(b));
+        x0 = (x0 << SHIFT) + (1 << (SHIFT - 1));
+    }
+    
+    Point end[2] = { p, p };
+    for (int k = 0; k < 2; k++) {
+        int gap = 0, dx = k ? -dx0 : dx0, dy = k ? -dy0 : dy0;
+        for (int x = x0, y = y0;; x += dx, y += dy) {
+            int px = xflag ? x : x >> SHIFT, py = xflag ? y >> SHIFT : y;
+            if (px < 0 || px >= width || py < 0 || py >= height)
+                break;
+            if (buf->mask.at<uchar>(py, px) != NOT_EDGE) {
+                gap = 0;
+                end[k] = Point(px, py);
+            }
+            else if (++gap > max_gap)
+                break;
+        }
+    }
+    bool good = abs(end[1].x - end[0].x) >= min_length || abs(end[1].y - end[0].y) >= min_length;
+    
+    // take the line's points out, so they don't vote for (or get found in) another line;
+    //  only the ones that voted have votes to take back
+    int unused;
+    for (int k = 0; k < 2; k++) {
+        int dx = k ? -dx0 : dx0, dy = k ? -dy0 : dy0;
+        for (int x = x0, y = y0;; x += dx, y += dy) {
+            int px = xflag ? x : x >> SHIFT, py = xflag ? y >> SHIFT : y;
+            uchar *m = buf->mask.ptr<uchar>(py) + px;
+            if (good && *m == VOTED)
+                vote(buf->accum, trig, numrho, px, py, -1, &unused);
+            *m = NOT_EDGE;
+            if (px == end[k].x && py == end[k].y)
+                break;
+        }
+    }
+    if (good)
+        lines->push_back(Vec4i(end[0].x, end[0].y, end[1].x, end[1].y));
+}
+
+// true once the time or point budget is used up (the clock is only read every ANYTIME_CHECK
+// points)
+static bool spent(double seconds, long points, double start, long voted)
+{
+    if (seconds > 0 && voted % ANYTIME_CHECK == 0 && voted > 0 && now() - start >= seconds)
+        return true;
+    return points > 0 && voted >= points;
+}
+
+// moves a random point of the count left to the end of the list and returns it
+static Point draw_point(vector<Point> &points, int count, RNG &rng)
+{
+    int idx = rng.uniform(0, count);
+    Point p = points[idx];
+    points[idx] = points[count - 1];
+    points[count - 1] = p;                  // kept past the end, for the coverage count
+    return p;
+}
+
+// most votes first (then the lower bin, so the order is repeatable)
+static bool stronger_peak(const Vec2i &a, const Vec2i &b)
+{
+    return a[0] > b[0] || (a[0] == b[0] && a[1] < b[1]);
+}
+
+// takes the lines of the bins at or over the threshold out, the most votes first; each is
+// walked from one of the seed points on it (the bins' counts only drop as lines go, so
+// each is checked again before its turn)
+static void take_peaks(hough_buffers *buf, const float *trig, int numrho, const Point *seeds, int num_seeds,
+                       int threshold, int min_length, int max_gap, const hough_budget *limit, double start,
+                       vector<Vec4i> *lines)
+{
+    const int *acc = buf->accum.ptr<int>();
+    int bins = NUM_ANGLES * numrho;
+    buf->peaks.clear();
+    for (int i = 0; i < bins; i++)
+        if (acc[i] >= threshold)
+            buf->peaks.push_back(Vec2i(acc[i], i));
+    sort(buf->peaks.begin(), buf->peaks.end(), stronger_peak);
+    
+    for (size_t i = 0; i < buf->peaks.size(); i++) {
+        if (limit->seconds > 0 && now() - start >= limit->seconds)
+            break;
+        int bin = buf->peaks[i][1];
+        if (acc[bin] < threshold)
+            continue;
+        int n = bin / numrho, r = bin % numrho - (numrho - 1) / 2;
+        for (int j = 0; j < num_seeds; j++) {
+            Point p = seeds[j];
+            if (buf->mask.at<uchar>(p.y, p.x) == VOTED &&
+                cvRound(p.x * trig[2*n] + p.y * trig[2*n + 1]) == r) {
+                take_line(buf, trig, numrho, p, n, min_length, max_gap, lines);
+                break;
+            }
+        }
+    }
+}
+
+// two passes: the first ANYTIME_PEAK_SHARE of the points (and of the time budget) only vote,
+// then the bins that reached the threshold are taken out strongest first, so the lines a
+// short budget keeps are the strongest ones in the frame; after that it is HoughLinesP:
+// points are drawn at random from the ones left, and once a point's bin reaches the
+// threshold its line is taken out
+double anytime_hough(const Mat &edges, hough_buffers *buf, const hough_budget *limit,
+                     int threshold, int min_length, int max_gap, vector<Vec4i> *lines)
+{
+    double start = now();
+    int width = edges.cols, height = edges.rows;
+    int numrho = (width + height) * 2 + 1;
+    lines->clear();
+    
+    float trig[NUM_ANGLES * 2];
+    for (int n = 0; n < NUM_ANGLES; n++) {
+        trig[2*n] = (float)cos(n * CV_PI / NUM_ANGLES);
+        trig[2*n + 1] = (float)sin(n * CV_PI / NUM_ANGLES);
+    }
+    buf->accum.create(NUM_ANGLES, numrho, CV_32SC1);
+    buf->accum.setTo(Scalar(0));
+    buf->mask.create(height, width, CV_8UC1);
+    buf->points.clear();
+    for (int y = 0; y < height; y++) {
+        const uchar *e = edges.ptr<uchar>(y);
+        uchar *m = buf->mask.ptr<uchar>(y);
+        for (int x = 0; x < width; x++) {
+            m[x] = e[x] ? UNVOTED : NOT_EDGE;
+            if (e[x])
+                buf->points.push_back(Point(x, y));
+        }
+    }
+    
+    vector<Point> &points = buf->points;
+    long total = (long)points.size(), voted = 0;
+    if (total == 0)
+        return 1;
+    int count = (int)total;
+    RNG rng(ANYTIME_SEED);
+    
+    // seed pass: vote only (nothing has been taken out yet, so every point drawn votes)
+    long seed_points = (long)((limit->points > 0 ? min(total, limit->points) : total) * ANYTIME_PEAK_SHARE);
+    for (; count > 0 && voted < seed_points; count--) {
+        if (spent(limit->seconds * ANYTIME_PEAK_SHARE, 0, start, voted))
+            break;
+        Point p = draw_point(points, count, rng);
+        int unused;
+        vote(buf->accum, trig, numrho, p.x, p.y, 1, &unused);
+        buf->mask.at<uchar>(p.y, p.x) = VOTED;
+        voted++;
+    }
+    take_peaks(buf, trig, numrho, &points[0] + count, (int)voted, threshold, min_length, max_gap,
+               limit, start, lines);
+    
+    for (; count > 0; count--) {
+        if (spent(limit->seconds, limit->points, start, voted))
+            break;
+        Point p = draw_point(points, count, rng);
+        uchar *mp = buf->mask.ptr<uchar>(p.y) + p.x;
+        if (*mp != UNVOTED)                 // taken out with an earlier line
+            continue;
+    
+        int n = 0;
+        int votes = vote(buf->accum, trig, numrho, p.x, p.y, 1, &n);
+        *mp = VOTED;
+        voted++;
+        if (votes >= threshold)
+            take_line(buf, trig, numrho, p, n, min_length, max_gap, lines);
+    }
+    
+    // points never drawn that are still edges weren't looked at
+    long untouched = 0;
+    for (int i = 0; i < count; i++)
+        untouched += buf->mask.at<uchar>(points[i].y, points[i].x) == UNVOTED;
+    return 1.0 - (double)untouched / total;
+}
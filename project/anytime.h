@@ -0,0 +1,48 @@
+//
+//  anytime.h
+//  opencv
+//
+//  "anytime" probabilistic Hough transform: HoughLinesP (edge points vote in random order,
+//  a line is walked and taken out as soon as its bin reaches the threshold), but it stops
+//  when a time or vote budget runs out and reports how much of the edge map it got through
+//
+//  HoughLinesP's order only favours long lines on average, so a random sample of the points
+//  votes first and the bins it lifts over the threshold are taken out by vote count: the
+//  strongest lines come out first, and a budget cut drops the weakest
+//
+//  the stage's latency is then bounded by the budget (plus one check interval and the
+//  scan that collects the edge points, which only depends on the frame size)
+
+#ifndef opencv_anytime_h
+#define opencv_anytime_h
+
+#include "project.h"
+
+const double ANYTIME_BUDGET_MS = 5.0;       // default time budget per frame
+const int ANYTIME_CHECK = 64;               // points voted between clock checks
+const uint64 ANYTIME_SEED = 0x4a4e;         // same point order every run (repeatable results)
+const double ANYTIME_PEAK_SHARE = 0.25;     // share of the points (and of the time budget) in the
+                                            //  vote-only first pass
+
+struct hough_budget {
+    double seconds;                         // time budget, 0 = none
+    long points;                            // edge points that may vote, 0 = none
+};
+
+// accumulator, edge mask and point list, kept between frames (same size: no allocation)
+struct hough_buffers {
+    Mat accum;
+    Mat mask;
+    vector<Point> points;
+    vector<Vec2i> peaks;                    // (votes, bin) over the threshold after the first pass
+};
+
+void set_hough_budget(double, long);        // budget of every anytime stage (ms, points)
+const hough_budget *get_hough_budget();
+bool parse_hough_budget(const char *);      // "ms[,points]" for -H
+
+// HoughLinesP(edges, lines, 1, CV_PI/180, threshold, min_length, max_gap) within a budget
+//  returns the fraction of edge points voted or taken out with a line (1 = all of them)
+double anytime_hough(const Mat &, hough_buffers *, const hough_budget *, int, int, int, vector<Vec4i> *);
+
+#endif
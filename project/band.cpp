@@ -0,0 +1,151 @@
+//
+//  band.cpp
+//  opencv
+//
+
+#include "band.h"
+
+// change in x per row of a segment stored top endpoint first (not horizontal)
+static double dx_dy(Vec4i l)
+{
+    return (l[X2] - l[X1]) / (double)(l[Y2] - l[Y1]);
+}
+
+static bool higher(Vec4i a, Vec4i b)
+{
+    return a[Y1] < b[Y1];
+}
+
+// adds one band's segments to the image's segments, top to bottom, merging each into a
+// segment it continues: one that reached the bottom of the band above, or one already
+// added from this band (HoughLinesP often returns a zig-zag edge as overlapping pieces)
+//  lines: in band coordinates, band = image rows [y0, y1)
+//  open: indices of segments ending at the last border, replaced by those ending at y1
+static void join_band(vector<Vec4i> *segments, vector<int> *open, const vector<Vec4i> &lines, int y0, int y1)
+{
+    // image coordinates, top endpoint first
+    vector<Vec4i> band;
+    for (size_t i = 0; i < lines.size(); i++) {
+        Vec4i l = lines[i];
+        if (l[Y1] <= l[Y2])
+            band.push_back(Vec4i(l[X1], l[Y1]+y0, l[X2], l[Y2]+y0));
+        else
+            band.push_back(Vec4i(l[X2], l[Y2]+y0, l[X1], l[Y1]+y0));
+    }
+    sort(band.begin(), band.end(), higher);
+    
+    vector<int> candidates = *open;
+    for (size_t i = 0; i < band.size(); i++) {
+        Vec4i s = band[i];
+        if (s[Y2] == s[Y1]) {               // horizontal: can't continue anything
+            segments->push_back(s);
+            continue;
+        }
+        bool merged = false;
+        for (size_t j = 0; j < candidates.size() && !merged; j++) {
+            Vec4i &o = (*segments)[candidates[j]];
+            if (s[Y1] <= o[Y2] + BAND_JOIN_GAP && abs(x_at(o, s[Y1]) - s[X1]) <= BAND_JOIN_GAP &&
+                abs(dx_dy(o) - dx_dy(s)) <= BAND_JOIN_SLOPE) {
+                if (s[Y2] > o[Y2]) {
+                    o[X2] = s[X2];
+                    o[Y2] = s[Y2];
+                }
+                merged = true;
+            }
+        }
+        if (!merged) {
+            candidates.push_back((int)segments->size());
+            segments->push_back(s);
+        }
+    }
+    
+    open->clear();
+    for (size_t j = 0; j < candidates.size(); j++)
+        if (y1 - 1 - (*segments)[candidates[j]][Y2] <= BAND_JOIN_GAP)
+            open->push_back(candidates[j]);
+}
+
+// runs Canny + HoughLinesP over the image one band at a time, then the reference
+// engine's model stage (combine_lines + extend_lines) over the joined segments
+//  no edge map is kept (det->edges is left empty); returns -1 if a row can't be read
+int detect_bands(band_source *src, int band_rows, detector *det, band_stats *stats)
+{
+    Size size = src->size;
+    band_rows = max(band_rows, 2*BAND_OVERLAP);     // the overlap has to fit in the next band
+    det->size = size;
+    det->segments.clear();
+    det->edges.release();
+    stats->bands = 0;
+    stats->read_time = stats->edge_time = stats->segment_time = 0;
+    
+    // buf row i holds image row y0 - BAND_OVERLAP + i (the first band has nothing above it)
+    Mat buf(band_rows + 2*BAND_OVERLAP, size.width, CV_8UC1);
+    Mat edges;
+    vector<Vec4i> lines;
+    vector<int> open;
+    int valid = BAND_OVERLAP;               // rows of buf holding image rows
+    
+    for (int y0 = 0; y0 < size.height; y0 += band_rows) {
+        int y1 = min(y0 + band_rows, size.height);
+        
+        double t0 = now();
+        TRACE_BEGIN("decode");
+        int want = min(buf.rows - valid, size.height - src->next_row);
+        if (want > 0) {
+            Mat rows = buf.rowRange(valid, valid + want);
+            if (!read_rows(src, rows)) {
+                cout << "cannot read " << src->name << " at row " << src->next_row << endl;
+                return -1;
+            }
+            valid += want;
+        }
+        // rows above the image / past its end repeat the edge row, as Canny's border does
+        if (y0 == 0)
+            for (int i = 0; i < BAND_OVERLAP; i++)
+                buf.row(BAND_OVERLAP).copyTo(buf.row(i));
+        for (int i = valid; i < buf.rows; i++)
+            buf.row(valid - 1).copyTo(buf.row(i));
+        TRACE_END("decode");
+        
+        double t1 = now();
+        TRACE_BEGIN("Canny");
+        Canny(buf, edges, CANNY_T1, CANNY_T2, CANNY_APERTURE);
+        TRACE_END("Canny");
+        
+        double t2 = now();
+        TRACE_BEGIN("HoughLinesP");
+        HoughLinesP(edges.rowRange(BAND_OVERLAP, BAND_OVERLAP + y1 - y0), lines,
+                    1, CV_PI/180, HLINES_THRESH, HLINES_MINLINE, HLINES_MINGAP);
+        join_band(&det->segments, &open, lines, y0, y1);
+        TRACE_END("HoughLinesP");
+        double t3 = now();
+        
+        // slide down: the rows below this band become the top of the next one
+        if (valid > band_rows) {
+            buf.rowRange(band_rows, valid).copyTo(buf.rowRange(0, valid - band_rows));
+            valid -= band_rows;
+        }
+        stats->bands++;
+        stats->read_time += t1 - t0;
+        stats->edge_time += t2 - t1;
+        stats->segment_time += t3 - t2;
+    }
+    
+    double t0 = now();
+    remove_horizontal(&det->segments);
+    combine_model(det, det->segments, &det->lane_lines);
+    build_lane_index(&det->index, det->lane_lines, det->size);
+    det->model_time = now() - t0;
+    det->edge_time = stats->edge_time;
+    det->segment_time = stats->segment_time;
+    return 0;
+}
+
+// decoded band, Canny and HoughLinesP buffers, and the Hough accumulator
+// (180 angles x 2*(width+height)+1 distances, ints), which grows with the band's width
+size_t band_memory_bound(Size size, int band_rows)
+{
+    size_t rows = band_rows + 2*BAND_OVERLAP;
+    size_t accumulator = 180 * (2*(size_t)(size.width + band_rows) + 1) * sizeof(int);
+    return rows * size.width * BAND_BYTES_PER_PIXEL + accumulator;
+}
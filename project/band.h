@@ -0,0 +1,34 @@
+//
+//  band.h
+//  opencv
+//
+//  band-streaming detection for very large images (aerial and stitched surveys):
+//  the image is decoded and run through Canny + HoughLinesP BAND_ROWS rows at a time,
+//  and segments that cross a band border are joined back together, so the working
+//  memory depends on the band size and the image width, not on the image height
+
+#ifndef opencv_band_h
+#define opencv_band_h
+
+#include "engine.h"
+#include "source.h"
+
+const int BAND_ROWS = 256;                  // default rows per band
+const int BAND_OVERLAP = 8;                 // rows decoded above and below each band, so Canny's
+                                            //  gradients and hysteresis see the real neighbours at a border
+const int BAND_JOIN_GAP = HLINES_MINGAP;    // how far (px) segment ends at a border may be apart to be joined
+const double BAND_JOIN_SLOPE = 0.10;        // how much (in dx/dy) their directions may differ
+
+// working memory per band pixel: decoded rows, Canny's gradients/magnitudes/map, edge map,
+// and HoughLinesP's copy of it (bytes)
+const int BAND_BYTES_PER_PIXEL = 16;
+
+struct band_stats {
+    int bands;
+    double read_time, edge_time, segment_time;  // totals over all bands (s)
+};
+
+int detect_bands(band_source *, int, detector *, band_stats *);    // whole image, band by band
+size_t band_memory_bound(Size, int);        // working memory (bytes) detect_bands() should stay within
+
+#endif
@@ -0,0 +1,466 @@
+//
+//  bench.cpp
+//  opencv
+//
+
+#include "bench.h"
+#include <cstdio>
+
+// ===================================================================
+// engines - latency and agreement with the reference engine
+// ===================================================================
+
+// runs every registered engine over the same frames
+//  latency: average and worst time of the three stages, over all runs of all frames
+//  agreement: fraction of the reference engine's lane lines the engine also found
+//  truth: the same against the ground truth, if every image has one (see synth.h)
+// returns -1 if a frame can't be loaded
+int benchmark_engines(const vector<string> &files)
+{
+    int n = num_engines();
+    const lane_engine *reference = find_engine(REFERENCE_ENGINE);
+    vector<double> edge(n, 0), segment(n, 0), model(n, 0), worst(n, 0), agree(n, 0), truth(n, 0);
+    bool have_truth = true;
+    
+    for (size_t f = 0; f < files.size(); f++) {
+        Mat frame = imread(files[f], IMREAD_COLOR), src;
+        if (frame.empty()) {
+            cout << "cannot open " << files[f] << endl;
+            return -1;
+        }
+        to_luma(frame, src);
+        
+        vector<Vec4i> truth_lines;
+        have_truth = have_truth && read_truth(truth_file(files[f]), &truth_lines);
+        
+        detector ref;
+        init_detector(&ref, reference);
+        run_detector(&ref, src);
+        
+        for (int e = 0; e < n; e++) {
+            detector det;
+            init_detector(&det, get_engine(e));
+            det.colour = frame;
+            run_detector(&det, src);        // warm-up (first-touch allocations, lookup tables)
+            for (int r = 0; r < BENCH_RUNS; r++) {
+                run_detector(&det, src);
+                double total = det.edge_time + det.segment_time + det.model_time;
+                edge[e] += det.edge_time;
+                segment[e] += det.segment_time;
+                model[e] += det.model_time;
+                worst[e] = max(worst[e], total);
+            }
+            agree[e] += agreement(ref.lane_lines, det.lane_lines, src.rows);
+            truth[e] += agreement(truth_lines, det.lane_lines, src.rows);
+        }
+    }
+    
+    double runs = (double)files.size() * BENCH_RUNS / 1000;     // to get ms per run
+    cout << files.size() << " frame(s), " << BENCH_RUNS << " runs each, reference: "
+         << REFERENCE_ENGINE << endl;
+    cout << "engine      edge (ms)   segment (ms)   model (ms)   total (ms)   worst (ms)   agreement     truth" << endl;
+    for (int e = 0; e < n; e++) {
+        printf("%-10s  %9.3f   %12.3f   %10.3f   %10.3f   %10.3f   %8.1f%%", get_engine(e)->name,
+               edge[e]/runs, segment[e]/runs, model[e]/runs, (edge[e]+segment[e]+model[e])/runs,
+               worst[e]*1000, 100 * agree[e] / files.size());
+        if (have_truth)
+            printf("   %6.1f%%\n", 100 * truth[e] / files.size());
+        else
+            printf("         -\n");
+    }
+    return 0;
+}
+
+// ===================================================================
+// engine pairs - edges, segments and stage times of two engines side by side
+// ===================================================================
+
+// fields of a pair_run row (sums)
+enum { PAIR_EDGE_PX, PAIR_SEGMENTS, PAIR_COMBINED, PAIR_EDGE, PAIR_SEGMENT, PAIR_MODEL, PAIR_FIELDS };
+
+// edge pixels, segments, combined lines and stage times of one engine on one frame (stage
+// times averaged over BENCH_RUNS), added to the totals in sums
+static void pair_run(const char *file, const char *label, const lane_engine *engine,
+                     const Mat &frame, const Mat &src, vector<double> *sums)
+{
+    detector det;
+    init_detector(&det, engine);
+    det.colour = frame;
+    run_detector(&det, src);            // warm-up
+    double edge = 0, segment = 0, model = 0;
+    for (int r = 0; r < BENCH_RUNS; r++) {
+        run_detector(&det, src);
+        edge += det.edge_time;
+        segment += det.segment_time;
+        model += det.model_time;
+    }
+    double ms = 1000.0 / BENCH_RUNS;
+    double row[PAIR_FIELDS] = { (double)countNonZero(det.edges), (double)det.segments.size(),
+                                (double)det.combined.size(), edge*ms, segment*ms, model*ms };
+    printf("%-20s  %-6s  %9d  %8d  %8d  %9.3f  %12.3f  %10.3f  %5d\n", file, label, (int)row[0], (int)row[1],
+           (int)row[2], row[3], row[4], row[5], (int)det.lane_lines.size());
+    for (int i = 0; i < PAIR_FIELDS; i++)
+        (*sums)[i] += row[i];
+}
+
+static void pair_total(const char *label, const vector<double> &sums)
+{
+    printf("%-20s  %-6s  %9d  %8d  %8d  %9.3f  %12.3f  %10.3f\n", "total", label, (int)sums[0], (int)sums[1],
+           (int)sums[2], sums[3], sums[4], sums[5]);
+}
+
+// runs two engines on every image (decoded in colour), one row each per image, then the
+// totals; a_sums, b_sums get the totals
+static int pair_table(const vector<string> &files, const char *column, const lane_engine *a, const char *a_label,
+                      const lane_engine *b, const char *b_label, vector<double> *a_sums, vector<double> *b_sums)
+{
+    a_sums->assign(PAIR_FIELDS, 0);
+    b_sums->assign(PAIR_FIELDS, 0);
+    printf("image                 %-6s    edge px  segments  combined  edge (ms)  segment (ms)  model (ms)  lines\n", column);
+    for (size_t f = 0; f < files.size(); f++) {
+        Mat frame = imread(files[f], IMREAD_COLOR), src;
+        if (frame.empty()) {
+            cout << "cannot open " << files[f] << endl;
+            return -1;
+        }
+        to_luma(frame, src);
+        string name = files[f].substr(files[f].find_last_of('/') + 1);
+        pair_run(name.c_str(), a_label, a, frame, src, a_sums);
+        pair_run(name.c_str(), b_label, b, frame, src, b_sums);
+    }
+    pair_total(a_label, *a_sums);
+    pair_total(b_label, *b_sums);
+    return 0;
+}
+
+static double stage_time(const vector<double> &sums)
+{
+    return sums[PAIR_EDGE] + sums[PAIR_SEGMENT] + sums[PAIR_MODEL];
+}
+
+// mask - how many edges the lane-paint mask prunes, and what that saves: the reference
+// engine against the paint engine (the same stages plus the lane-paint mask)
+int benchmark_mask(const vector<string> &files)
+{
+    const lane_engine *plain = find_engine(REFERENCE_ENGINE), *paint = find_engine("paint");
+    vector<double> off, on;
+    
+    cout << files.size() << " frame(s), " << BENCH_RUNS << " runs each; mask off: "
+         << plain->name << ", mask on: " << paint->name << endl;
+    if (pair_table(files, "mask", plain, "off", paint, "on", &off, &on) != 0)
+        return -1;
+    printf("edge pixels kept: %.1f%%, segments kept: %.1f%%, edge+segment+model time: %.1f%%\n",
+           100 * on[PAIR_EDGE_PX] / max(off[PAIR_EDGE_PX], 1.0), 100 * on[PAIR_SEGMENTS] / max(off[PAIR_SEGMENTS], 1.0),
+           100 * stage_time(on) / max(stage_time(off), 1e-9));
+    return 0;
+}
+
+// lsd - the line segment detector against Canny + HoughLinesP: how many fragments each
+// hands to combine_lines (segments) and how long the three stages take
+int benchmark_lsd(const vector<string> &files)
+{
+    const lane_engine *hough = find_engine(REFERENCE_ENGINE), *lsd = find_engine("lsd");
+    vector<double> h, l;
+    
+    cout << files.size() << " frame(s), " << BENCH_RUNS << " runs each; " << hough->name
+         << ": Canny + HoughLinesP, " << lsd->name << ": level-line regions; both + combine_lines" << endl;
+    if (pair_table(files, "engine", hough, hough->name, lsd, lsd->name, &h, &l) != 0)
+        return -1;
+    printf("lsd vs hough: fragments %.1f%%, combined lines %.1f%%, edge+segment time %.1f%%, "
+           "model time %.1f%%, total %.1f%%\n",
+           100 * l[PAIR_SEGMENTS] / max(h[PAIR_SEGMENTS], 1.0), 100 * l[PAIR_COMBINED] / max(h[PAIR_COMBINED], 1.0),
+           100 * (l[PAIR_EDGE] + l[PAIR_SEGMENT]) / max(h[PAIR_EDGE] + h[PAIR_SEGMENT], 1e-9),
+           100 * l[PAIR_MODEL] / max(h[PAIR_MODEL], 1e-9), 100 * stage_time(l) / max(stage_time(h), 1e-9));
+    return 0;
+}
+
+// ===================================================================
+// geometry - Vec4i/double vs seg16/fixed-point pairwise line tests
+// ===================================================================
+
+// the tests combine_lines() makes on a pair, double path (project.cpp)
+static int pair_tests_double(const vector<Vec4i> &lines, vector<uchar> *same)
+{
+    int n = (int)lines.size(), count = 0;
+    for (int i = 0; i < n; i++)
+        for (int j = 0; j < n; j++) {
+            bool s = same_line(lines[i], lines[j]);
+            (*same)[i*n + j] = s;
+            count += s && (adjacent(lines[i], lines[j]) || seperated(lines[i], lines[j]));
+        }
+    return count;
+}
+
+// the same tests on seg16 with compile-time tolerances (segment.h)
+static int pair_tests_fixed(const vector<seg16> &lines, vector<uchar> *same)
+{
+    int n = (int)lines.size(), count = 0;
+    for (int i = 0; i < n; i++)
+        for (int j = 0; j < n; j++) {
+            bool s = same_line_fixed(lines[i], lines[j]);
+            (*same)[i*n + j] = s;
+            count += s && (adjacent(lines[i], lines[j]) || seperated(lines[i], lines[j]));
+        }
+    return count;
+}
+
+// runs the reference engine's segment stage on each frame, then times every pairwise
+// same_line/adjacent/seperated test over its segments with both line representations
+//  reports memory per segment set, time per pair, and pairs the two paths disagree on
+int benchmark_geometry(const vector<string> &files)
+{
+    double t_double = 0, t_fixed = 0;
+    long pairs = 0, mismatches = 0;
+    size_t segments = 0;
+    
+    for (size_t f = 0; f < files.size(); f++) {
+        Mat src = imread(files[f], IMREAD_GRAYSCALE);
+        if (src.empty()) {
+            cout << "cannot open " << files[f] << endl;
+            return -1;
+        }
+        detector det;
+        init_detector(&det, find_engine(REFERENCE_ENGINE));
+        run_detector(&det, src);
+        
+        const vector<Vec4i> &lines = det.segments;
+        vector<seg16> compact(lines.size());
+        for (size_t i = 0; i < lines.size(); i++)
+            compact[i] = to_seg16(lines[i]);
+        size_t n = lines.size();
+        vector<uchar> same_double(n*n), same_fixed(n*n);
+        
+        int checksum = 0;
+        double t0 = now();
+        for (int r = 0; r < GEOMETRY_RUNS; r++)
+            checksum += pair_tests_double(lines, &same_double);
+        double t1 = now();
+        for (int r = 0; r < GEOMETRY_RUNS; r++)
+            checksum -= pair_tests_fixed(compact, &same_fixed);
+        double t2 = now();
+        
+        t_double += t1 - t0;
+        t_fixed += t2 - t1;
+        pairs += (long)n * n * GEOMETRY_RUNS;
+        segments += n;
+        for (size_t k = 0; k < n*n; k++)
+            mismatches += same_double[k] != same_fixed[k];
+        if (checksum != 0)
+            cout << files[f] << ": merge candidates differ between the paths" << endl;
+    }
+    
+    double ns = 1e9 / max(pairs, 1L);
+    cout << files.size() << " frame(s), " << segments << " segments, " << GEOMETRY_RUNS
+         << " passes over all pairs per frame" << endl;
+    cout << "path            bytes/segment   ns/pair   speedup" << endl;
+    printf("Vec4i/double    %13d   %7.2f   %7.2f\n", (int)sizeof(Vec4i), t_double * ns, 1.0);
+    printf("seg16/fixed     %13d   %7.2f   %7.2f\n", (int)sizeof(seg16), t_fixed * ns, t_double / max(t_fixed, 1e-9));
+    cout << "same_line disagreements: " << mismatches << endl;
+    return 0;
+}
+
+// ===================================================================
+// scaling - synthetic frames of increasing size and clutter
+// ===================================================================
+
+// frame sizes swept by the scaling benchmark, VGA to 8K
+const Size SCALING_SIZES[] = { Size(640, 480), Size(1280, 720), Size(1920, 1080), Size(3840, 2160), Size(7680, 4320) };
+// clutter strokes per frame (more clutter = more HoughLinesP segments), scaled by frame area over VGA's
+const int SCALING_CLUTTER[] = { 0, 20, 80 };
+
+// renders one scene per frame size and clutter level (the rest of the scene from base),
+// and runs every engine on it: time per frame, segments found, agreement with ground truth
+int benchmark_scaling(const scene_params *base)
+{
+    int n = num_engines();
+    int sizes = sizeof(SCALING_SIZES) / sizeof(SCALING_SIZES[0]);
+    int levels = sizeof(SCALING_CLUTTER) / sizeof(SCALING_CLUTTER[0]);
+    
+    cout << SCALING_RUNS << " runs per frame, " << base->lanes << " lane(s), curve " << base->curve << endl;
+    cout << "size         clutter  engine      total (ms)   ms/Mpx   segments   truth" << endl;
+    for (int s = 0; s < sizes; s++) {
+        for (int c = 0; c < levels; c++) {
+            scene_params p = *base;
+            p.size = SCALING_SIZES[s];
+            p.clutter = SCALING_CLUTTER[c] * (p.size.area() / (640 * 480));
+            vector<Vec4i> truth;
+            Mat frame = render_scene(&p, &truth), src;
+            cvtColor(frame, src, COLOR_BGR2GRAY);
+            
+            for (int e = 0; e < n; e++) {
+                detector det;
+                init_detector(&det, get_engine(e));
+                det.colour = frame;
+                run_detector(&det, src);        // warm-up
+                double total = 0;
+                for (int r = 0; r < SCALING_RUNS; r++) {
+                    run_detector(&det, src);
+                    total += det.edge_time + det.segment_time + det.model_time;
+                }
+                double ms = total / SCALING_RUNS * 1000;
+                printf("%5dx%-5d  %7d  %-10s  %10.3f  %7.3f  %9d  %5.1f%%\n", p.size.width, p.size.height,
+                       p.clutter, get_engine(e)->name, ms, ms / (p.size.area() / 1e6),
+                       (int)det.segments.size(), 100 * agreement(truth, det.lane_lines, src.rows));
+            }
+        }
+    }
+    return 0;
+}
+
+// ===================================================================
+// jitter - frame latency distribution with and without rt settings
+// ===================================================================
+
+double percentile(vector<double> &samples, double q)
+{
+    if (samples.empty())
+        return 0;
+    sort(samples.begin(), samples.end());
+    size_t i = (size_t)ceil(q * samples.size());
+    return samples[min(samples.size(), max(i, (size_t)1)) - 1];
+}
+
+// runs JITTER_RUNS frames of one engine on one image, in the main thread
+static void jitter_run(const char *label, detector *det, const Mat &src)
+{
+    vector<double> latency(JITTER_RUNS);
+    double sum = 0;
+    for (int r = 0; r < JITTER_RUNS; r++) {
+        double t0 = now();
+        run_detector(det, src);
+        latency[r] = (now() - t0) * 1000;
+        sum += latency[r];
+    }
+    double mean_ms = sum / JITTER_RUNS;
+    double p50 = percentile(latency, 0.50);
+    double p99 = percentile(latency, 0.99);
+    double p999 = percentile(latency, 0.999);
+    printf("%-10s  %9.3f  %9.3f  %9.3f  %10.3f  %9.3f\n", label, mean_ms, p50, p99, p999, latency.back());
+}
+
+// measures the tail of the frame latency twice on the same image: first with the
+// default scheduler, then pinned / real-time / memory-locked as configured
+//  engines that read the colour frame get it, as in a run (-C)
+//  OpenCV's own worker threads are turned off for both runs: the settings only reach the
+//  calling thread, so the tuned run would still have their scheduling in its tail
+int benchmark_jitter(const string &file, const lane_engine *engine, const rt_config *rt)
+{
+    setNumThreads(0);
+    Mat frame = imread(file, engine->colour ? IMREAD_COLOR : IMREAD_GRAYSCALE), src;
+    if (frame.empty()) {
+        cout << "cannot open " << file << endl;
+        return -1;
+    }
+    to_luma(frame, src);
+    detector det;
+    init_detector(&det, engine);
+    if (engine->colour)
+        det.colour = frame;
+    run_detector(&det, src);            // warm-up
+    
+    cout << JITTER_RUNS << " frames of " << file << " (" << engine->name << ") per setting" << endl;
+    cout << "setting     mean (ms)   p50 (ms)   p99 (ms)  p99.9 (ms)   max (ms)" << endl;
+    reset_thread_rt();
+    jitter_run("default", &det, src);
+    
+    if (!rt_enabled(rt)) {
+        cout << "(no -c/-r/-m settings given, nothing to compare against)" << endl;
+        return 0;
+    }
+    apply_process_rt(rt);
+    apply_thread_rt(rt, 0);
+    jitter_run("tuned", &det, src);
+    reset_thread_rt();
+    return 0;
+}
+
+// ===================================================================
+// bands - peak memory of band streaming on a synthetic image
+// ===================================================================
+
+// resets the process's peak resident set size (VmHWM) to its current size, so the next
+// peak_rss() is the peak of what ran in between; getrusage's ru_maxrss can't be reset, and
+// would hide any growth below an earlier peak (image loading, another mode)
+//  false if the kernel doesn't allow it (clear_refs needs Linux >= 4.0)
+static bool reset_peak_rss()
+{
+    FILE *f = fopen("/proc/self/clear_refs", "w");
+    if (f == NULL)
+        return false;
+    bool ok = fputs("5", f) >= 0;
+    return fclose(f) == 0 && ok;
+}
+
+// largest resident set size since the last reset_peak_rss() (bytes, 0 if unknown)
+static size_t peak_rss()
+{
+    FILE *f = fopen("/proc/self/status", "r");
+    if (f == NULL)
+        return 0;
+    char line[128];
+    size_t kb = 0;
+    while (fgets(line, sizeof(line), f) != NULL)
+        if (sscanf(line, "VmHWM: %zu kB", &kb) == 1)
+            break;
+    fclose(f);
+    return kb * 1024;
+}
+
+// streams a side x side synthetic road (synth.h: straight, solid lines, rendered a row at a
+// time) through detect_bands() and checks that the peak RSS grew by no more than
+// band_memory_bound(), and that each lane line came out as one segment joined across the
+// bands (both ends on the painted line, covering >= 90% of its ground-truth chord)
+//  returns 0 if both hold, 1 if not
+int benchmark_bands(int side, int band_rows)
+{
+    Size size(side, side);
+    scene_params scene;
+    init_scene_params(&scene);
+    scene.size = size;
+    scene.dashed = false;
+    band_source src;
+    open_synthetic_bands(&src, &scene);
+    detector det;
+    init_detector(&det, find_engine(REFERENCE_ENGINE));
+    band_stats stats;
+    
+    if (!reset_peak_rss()) {
+        cout << "cannot reset the peak RSS (/proc/self/clear_refs), memory can't be checked" << endl;
+        return 1;
+    }
+    size_t before = peak_rss();
+    double start = now();
+    if (detect_bands(&src, band_rows, &det, &stats) != 0)
+        return 1;
+    double total = now() - start;
+    size_t growth = peak_rss() - before;
+    close_band_source(&src);
+    
+    // Canny finds the two sides of a painted line: ends may be off its centre by its width
+    int lines = scene.lanes + 1, found = 0;
+    double tolerance = SYNTH_LINE_WIDTH * side + BAND_JOIN_GAP;
+    for (int i = 0; i < lines; i++) {
+        Vec4i painted = scene_line(&scene, i);
+        for (size_t j = 0; j < det.segments.size(); j++) {
+            Vec4i s = det.segments[j];
+            if (abs(x_at(painted, s[Y1]) - s[X1]) <= tolerance && abs(x_at(painted, s[Y2]) - s[X2]) <= tolerance &&
+                abs(s[Y2] - s[Y1]) >= 0.9 * abs(painted[Y1] - painted[Y2])) {
+                found++;
+                break;
+            }
+        }
+    }
+    
+    size_t bound = band_memory_bound(size, band_rows);
+    double mb = 1024.0 * 1024;
+    printf("%dx%d synthetic image, %d bands of %d rows, %.2f s (decode %.2f, canny %.2f, hough %.2f)\n",
+           side, side, stats.bands, band_rows, total, stats.read_time, stats.edge_time, stats.segment_time);
+    printf("peak memory growth: %.1f MB (bound %.1f MB; whole-image src+dst+cdst: %.1f MB)\n",
+           growth / mb, bound / mb, 5.0 * side * side / mb);
+    printf("segments: %d, painted lines found whole: %d of %d\n",
+           (int)det.segments.size(), found, lines);
+    
+    bool ok = growth <= bound && found == lines;
+    cout << (ok ? "PASS" : "FAIL") << endl;
+    return ok ? 0 : 1;
+}
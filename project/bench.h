@@ -0,0 +1,38 @@
+//
+//  bench.h
+//  opencv
+//
+//  benchmark harnesses (selected from the command line, print a table to stdout)
+
+#ifndef opencv_bench_h
+#define opencv_bench_h
+
+#include "engine.h"
+#include "rt.h"
+#include "band.h"
+#include "synth.h"
+#include "segment.h"
+#include "source.h"
+
+// number of timed runs per engine per frame (after one warm-up run)
+const int BENCH_RUNS = 20;
+
+// timed runs per engine per frame size of the scaling benchmark
+const int SCALING_RUNS = 5;
+
+// passes over all segment pairs of a frame, per path, in the geometry benchmark
+const int GEOMETRY_RUNS = 2000;
+
+// frames per run of the jitter benchmark (p99.9 needs well over 1000 samples)
+const int JITTER_RUNS = 5000;
+
+int benchmark_engines(const vector<string> &);     // every registered engine over the same frames
+int benchmark_mask(const vector<string> &);        // edges/segments/stage times with the lane-paint mask off and on
+int benchmark_lsd(const vector<string> &);         // the same, Canny + HoughLinesP vs the line segment detector
+int benchmark_jitter(const string &, const lane_engine *, const rt_config *);  // latency tail, default vs rt settings
+int benchmark_geometry(const vector<string> &);    // Vec4i/double vs seg16/fixed-point line tests
+int benchmark_scaling(const scene_params *);       // every engine over synthetic frames from VGA to 8K
+int benchmark_bands(int, int);                     // band mode peak memory on a synthetic square image
+double percentile(vector<double> &, double);        // sorts the samples, returns the q-th quantile
+
+#endif
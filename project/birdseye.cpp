@@ -0,0 +1,165 @@
+//
+//  birdseye.cpp
+//  opencv
+//
+
+#include "birdseye.h"
+
+// ===================================================================
+// remap table - computed once per camera calibration
+// ===================================================================
+
+// builds the top-down -> image homography from the calibration trapezoid, then
+// evaluates it for every top-down pixel once, so each frame is a single remap()
+void make_birdseye_lut(birdseye_lut *lut, Size size)
+{
+    double w = size.width, h = size.height;
+
+    // trapezoid corners: topleft, bottomleft, bottomright, topright (same order as draw_lanes)
+    Point2f img_pts[4] = {
+        Point2f(w*BEV_TOP_LEFT,  h*BEV_TOP_Y),
+        Point2f(w*BEV_BOT_LEFT,  h-1),
+        Point2f(w*BEV_BOT_RIGHT, h-1),
+        Point2f(w*BEV_TOP_RIGHT, h*BEV_TOP_Y)
+    };
+    Point2f bev_pts[4] = {
+        Point2f(0, 0),
+        Point2f(0, BEV_HEIGHT-1),
+        Point2f(BEV_WIDTH-1, BEV_HEIGHT-1),
+        Point2f(BEV_WIDTH-1, 0)
+    };
+    lut->bev_to_img = getPerspectiveTransform(bev_pts, img_pts);
+
+    // remap() wants, for each destination pixel, where to sample in the source
+    Mat map_x(BEV_HEIGHT, BEV_WIDTH, CV_32FC1);
+    Mat map_y(BEV_HEIGHT, BEV_WIDTH, CV_32FC1);
+    const double *m = lut->bev_to_img.ptr<double>(0);
+    for (int v = 0; v < BEV_HEIGHT; v++) {
+        float *mx = map_x.ptr<float>(v);
+        float *my = map_y.ptr<float>(v);
+        for (int u = 0; u < BEV_WIDTH; u++) {
+            double z = m[6]*u + m[7]*v + m[8];
+            mx[u] = (float)((m[0]*u + m[1]*v + m[2]) / z);
+            my[u] = (float)((m[3]*u + m[4]*v + m[5]) / z);
+        }
+    }
+    // fixed-point tables are much faster to remap() with than float ones
+    convertMaps(map_x, map_y, lut->map1, lut->map2, CV_16SC2);
+    lut->src_size = size;
+}
+
+// ===================================================================
+// per-frame stages
+// ===================================================================
+
+// warps the road ROI of a grayscale image to the top-down view, and runs Canny on it
+//  Canny only sees BEV_WIDTH*BEV_HEIGHT pixels, none of them sky or roadside
+void birdseye_edges(const Mat &src, Mat &edges, birdseye_lut *lut)
+{
+    if (lut->src_size != src.size())
+        make_birdseye_lut(lut, src.size());
+
+    Mat bev;
+    remap(src, bev, lut->map1, lut->map2, INTER_LINEAR, BORDER_CONSTANT);
+    Canny(bev, edges, CANNY_T1, CANNY_T2, CANNY_APERTURE);
+}
+
+// finds lane lines in a top-down edge image:
+//  1. histogram of edge pixels per column (bottom half) gives the base x of each lane
+//  2. a window slides up from each base, re-centering on the edge pixels it contains
+//  3. a straight line x = a*y + b is fit through the pixels collected by the windows
+// lines are returned in top-down coordinates, bottom row to top row
+void birdseye_search(const Mat &edges, vector<Vec4i> *lanes)
+{
+    int rows = edges.rows, cols = edges.cols;
+    lanes->clear();
+
+    // column histogram of the bottom half (count of edge pixels)
+    vector<int> hist(cols, 0);
+    for (int y = rows / 2; y < rows; y++) {
+        const uchar *p = edges.ptr<uchar>(y);
+        for (int x = 0; x < cols; x++)
+            hist[x] += p[x] != 0;
+    }
+
+    // lane bases: strongest columns, at least BEV_PEAK_SPACING apart
+    vector<int> bases;
+    while ((int)bases.size() < BEV_MAX_LANES) {
+        int best = -1;
+        for (int x = 0; x < cols; x++)
+            if (hist[x] >= BEV_PEAK_MIN && (best < 0 || hist[x] > hist[best]))
+                best = x;
+        if (best < 0)
+            break;
+        bases.push_back(best);
+        for (int x = max(0, best-BEV_PEAK_SPACING); x < min(cols, best+BEV_PEAK_SPACING); x++)
+            hist[x] = 0;
+    }
+    sort(bases.begin(), bases.end());   // left to right
+
+    int win_height = rows / BEV_WINDOWS;
+    for (size_t i = 0; i < bases.size(); i++) {
+        int cx = bases[i];
+        // sums for least squares fit of x = a*y + b
+        double n = 0, sy = 0, sx = 0, syy = 0, sxy = 0;
+
+        for (int w = 0; w < BEV_WINDOWS; w++) {
+            int y_hi = rows - w*win_height;
+            int y_lo = y_hi - win_height;
+            int x_lo = max(0, cx - BEV_MARGIN);
+            int x_hi = min(cols, cx + BEV_MARGIN);
+            int count = 0;
+            long sum_x = 0;
+
+            for (int y = y_lo; y < y_hi; y++) {
+                const uchar *p = edges.ptr<uchar>(y);
+                for (int x = x_lo; x < x_hi; x++) {
+                    if (p[x]) {
+                        count++;
+                        sum_x += x;
+                        sy += y;
+                        sx += x;
+                        syy += (double)y*y;
+                        sxy += (double)x*y;
+                    }
+                }
+            }
+            n += count;
+            // follow the lane if the window had enough evidence
+            if (count > BEV_MINPIX)
+                cx = (int)(sum_x / count);
+        }
+
+        double det = n*syy - sy*sy;
+        if (n < BEV_MIN_POINTS || det == 0)
+            continue;
+        double a = (n*sxy - sy*sx) / det;
+        double b = (sx - a*sy) / n;
+        lanes->push_back(Vec4i((int)round(a*(rows-1) + b), rows-1, (int)round(b), 0));
+    }
+}
+
+// maps lines from top-down coordinates back to the source image
+//  endpoints are ordered so x1 <= x2, the way HoughLinesP stores them
+vector<Vec4i> birdseye_unwarp(const vector<Vec4i> &lanes, const birdseye_lut *lut)
+{
+    vector<Vec4i> new_lines;
+    if (lanes.empty())
+        return new_lines;
+
+    vector<Point2f> pts, img_pts;
+    for (size_t i = 0; i < lanes.size(); i++) {
+        pts.push_back(Point2f(lanes[i][X1], lanes[i][Y1]));
+        pts.push_back(Point2f(lanes[i][X2], lanes[i][Y2]));
+    }
+    perspectiveTransform(pts, img_pts, lut->bev_to_img);
+
+    for (size_t i = 0; i < lanes.size(); i++) {
+        Point p1 = img_pts[2*i], p2 = img_pts[2*i+1];
+        if (p1.x > p2.x)
+            new_lines.push_back(Vec4i(p2.x, p2.y, p1.x, p1.y));
+        else
+            new_lines.push_back(Vec4i(p1.x, p1.y, p2.x, p2.y));
+    }
+    return new_lines;
+}
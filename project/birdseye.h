@@ -0,0 +1,52 @@
+//
+//  birdseye.h
+//  opencv
+//
+//  bird's-eye (inverse perspective) lane detection:
+//  warps the road in front of the car to a top-down view, where lane lines are
+//  (close to) vertical and parallel, then finds them with column histograms and
+//  sliding windows instead of HoughLinesP + combine_lines
+
+#ifndef opencv_birdseye_h
+#define opencv_birdseye_h
+
+#include "project.h"
+
+// ---
+// camera calibration: road trapezoid in the source image, as fractions of width/height
+// (bottom edge is the bottom row of the image)
+// ---
+const double BEV_TOP_Y      = 0.60;         // y of the far edge of the road ROI
+const double BEV_TOP_LEFT   = 0.40;         // x of the far-left corner
+const double BEV_TOP_RIGHT  = 0.60;         // x of the far-right corner
+const double BEV_BOT_LEFT   = 0.00;         // x of the near-left corner
+const double BEV_BOT_RIGHT  = 1.00;         // x of the near-right corner
+
+// size of the top-down image (in px); independent of the source resolution
+const int BEV_WIDTH = 320;
+const int BEV_HEIGHT = 480;
+
+// ---
+// histogram / sliding window search
+// ---
+const int BEV_WINDOWS = 12;                 // number of windows stacked from bottom to top
+const int BEV_MARGIN = 20;                  // half-width of a window (in px)
+const int BEV_MINPIX = 15;                  // edge pixels needed in a window to re-center it
+const int BEV_PEAK_MIN = 10;                // edge pixels needed in a histogram column to start a lane
+const int BEV_PEAK_SPACING = 40;            // minimum distance between two lanes (in px)
+const int BEV_MAX_LANES = 6;                // maximum number of lane lines searched for
+const int BEV_MIN_POINTS = 60;              // edge pixels needed for a lane line to be kept
+
+// remap table for one camera calibration, only recomputed when the image size changes
+struct birdseye_lut {
+    Size src_size;                          // size of the image the table was made for
+    Mat map1, map2;                         // fixed-point remap() tables (CV_16SC2 + CV_16UC1)
+    Mat bev_to_img;                         // homography from top-down view back to the image
+};
+
+void make_birdseye_lut(birdseye_lut *, Size);               // (re)computes the remap table for an image size
+void birdseye_edges(const Mat &, Mat &, birdseye_lut *);    // warps grayscale ROI to top-down view, runs Canny
+void birdseye_search(const Mat &, vector<Vec4i> *);         // histogram + sliding windows (top-down coordinates)
+vector<Vec4i> birdseye_unwarp(const vector<Vec4i> &, const birdseye_lut *);  // lines back to image coordinates
+
+#endif
@@ -0,0 +1,230 @@
+//
+//  cache.cpp
+//  opencv
+//
+
+#include "cache.h"
+#include <pthread.h>
+#include <map>
+#include <deque>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+const cache_key FNV_PRIME = 1099511628211ULL;
+
+// header of a disk cache file, followed by rows*cols*elemSize bytes of data
+struct cache_file_header {
+    uint32_t magic;
+    int32_t rows, cols, type;
+};
+
+static bool cache_enabled = false;
+static string cache_dir;                    // empty: memory only
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static map<cache_key, Mat> entries;
+static deque<cache_key> order;              // insertion order, for dropping the oldest
+static size_t memory_bytes = 0;
+static cache_stats stats;
+
+void enable_stage_cache(const char *dir)
+{
+    cache_enabled = true;
+    cache_dir = dir != NULL ? dir : "";
+    if (!cache_dir.empty())
+        mkdir(cache_dir.c_str(), 0755);     // may exist already
+}
+
+bool stage_cache_enabled()
+{
+    return cache_enabled;
+}
+
+// ===================================================================
+// keys
+// ===================================================================
+
+cache_key hash_bytes(const void *data, size_t bytes, cache_key h)
+{
+    const uchar *p = (const uchar *)data;
+    size_t i = 0;
+    for (; i + 8 <= bytes; i += 8) {
+        uint64_t word;
+        memcpy(&word, p + i, 8);
+        h = (h ^ word) * FNV_PRIME;
+    }
+    for (; i < bytes; i++)
+        h = (h ^ p[i]) * FNV_PRIME;
+    return h;
+}
+
+cache_key hash_mat(const Mat &m, cache_key h)
+{
+    int header[3] = { m.rows, m.cols, m.type() };
+    h = hash_bytes(header, sizeof(header), h);
+    size_t row_bytes = m.cols * m.elemSize();
+    for (int y = 0; y < m.rows; y++)
+        h = hash_bytes(m.ptr(y), row_bytes, h);
+    return h;
+}
+
+cache_key hash_params(const char *stage, const double *values, int n, cache_key h)
+{
+    h = hash_bytes(stage, strlen(stage), h);
+    return hash_bytes(values, n * sizeof(double), h);
+}
+
+cache_key hash_file(const string &file)
+{
+    int fd = open(file.c_str(), O_RDONLY);
+    if (fd < 0)
+        return 0;
+    cache_key h = CACHE_SEED;
+    char buf[64 * 1024];
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) > 0)
+        h = hash_bytes(buf, n, h);
+    close(fd);
+    return n < 0 ? 0 : h;
+}
+
+// ===================================================================
+// memory
+// ===================================================================
+
+// adds an entry (lock held), dropping the oldest ones to stay within CACHE_MEMORY
+static void remember(cache_key key, const Mat &m)
+{
+    if (entries.count(key))
+        return;
+    size_t bytes = m.total() * m.elemSize();
+    while (!order.empty() && memory_bytes + bytes > CACHE_MEMORY) {
+        Mat &old = entries[order.front()];
+        memory_bytes -= old.total() * old.elemSize();
+        entries.erase(order.front());
+        order.pop_front();
+    }
+    entries[key] = m;
+    order.push_back(key);
+    memory_bytes += bytes;
+}
+
+// ===================================================================
+// disk
+// ===================================================================
+
+static string entry_path(cache_key key)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx.mat", (unsigned long long)key);
+    return cache_dir + name;
+}
+
+// maps a cache file and copies it into a new Mat; false if missing, damaged or not a
+// cache file (a type OpenCV doesn't have, a size that doesn't match the file's)
+static bool load_entry(cache_key key, Mat &m)
+{
+    int fd = open(entry_path(key).c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    bool ok = fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(cache_file_header);
+    void *p = ok ? mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (p == MAP_FAILED)
+        return false;
+    
+    const cache_file_header *h = (const cache_file_header *)p;
+    size_t data = st.st_size - sizeof(cache_file_header);
+    ok = h->magic == CACHE_MAGIC && h->rows >= 0 && h->cols >= 0 &&
+         (h->type & ~CV_MAT_TYPE_MASK) == 0 && CV_MAT_DEPTH(h->type) <= CV_64F;
+    // a row's bytes fit a size_t (int cols x at most CV_CN_MAX x 8 bytes); the row count is
+    //  checked against the file size before multiplying
+    size_t row = ok ? (size_t)h->cols * CV_ELEM_SIZE(h->type) : 0;
+    ok = ok && (h->rows == 0 || row <= data / h->rows) && (size_t)h->rows * row == data;
+    if (ok)
+        Mat(h->rows, h->cols, h->type, (uchar *)p + sizeof(cache_file_header)).copyTo(m);
+    munmap(p, st.st_size);
+    return ok;
+}
+
+// writes to a temporary file and renames it, so readers never see half an entry
+static void store_entry(cache_key key, const Mat &m)
+{
+    string path = entry_path(key);
+    char tmp[64];
+    snprintf(tmp, sizeof(tmp), ".%d.tmp", (int)getpid());
+    string tmp_path = path + tmp;
+    
+    FILE *f = fopen(tmp_path.c_str(), "wb");
+    if (f == NULL)
+        return;
+    cache_file_header h = { CACHE_MAGIC, m.rows, m.cols, m.type() };
+    bool ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+              fwrite(m.data, m.elemSize(), m.total(), f) == m.total();
+    ok = fclose(f) == 0 && ok;
+    if (!ok || rename(tmp_path.c_str(), path.c_str()) != 0)
+        unlink(tmp_path.c_str());
+}
+
+// ===================================================================
+// lookups
+// ===================================================================
+
+// the entry is copied out, so the caller may write into it (stages reuse their buffers)
+bool cache_get(cache_key key, Mat &m)
+{
+    pthread_mutex_lock(&cache_lock);
+    map<cache_key, Mat>::iterator it = entries.find(key);
+    if (it != entries.end()) {
+        it->second.copyTo(m);
+        stats.memory_hits++;
+        pthread_mutex_unlock(&cache_lock);
+        return true;
+    }
+    pthread_mutex_unlock(&cache_lock);
+    
+    // loaded into a Mat of its own, which the memory cache keeps (m is the caller's, who
+    //  may write into it later)
+    Mat loaded;
+    if (cache_dir.empty() || !load_entry(key, loaded)) {
+        pthread_mutex_lock(&cache_lock);
+        stats.misses++;
+        pthread_mutex_unlock(&cache_lock);
+        return false;
+    }
+    loaded.copyTo(m);
+    pthread_mutex_lock(&cache_lock);
+    remember(key, loaded);
+    stats.disk_hits++;
+    pthread_mutex_unlock(&cache_lock);
+    return true;
+}
+
+void cache_put(cache_key key, const Mat &m)
+{
+    CV_Assert(m.empty() || (m.dims == 2 && m.isContinuous()));
+    if (!cache_dir.empty())
+        store_entry(key, m);
+    pthread_mutex_lock(&cache_lock);
+    remember(key, m.clone());
+    stats.stores++;
+    pthread_mutex_unlock(&cache_lock);
+}
+
+void get_cache_stats(cache_stats *s)
+{
+    pthread_mutex_lock(&cache_lock);
+    *s = stats;
+    pthread_mutex_unlock(&cache_lock);
+}
+
+void print_cache_stats()
+{
+    cache_stats s;
+    get_cache_stats(&s);
+    cout << "cache: " << s.memory_hits << " memory hits, " << s.disk_hits << " disk hits, "
+         << s.misses << " misses, " << s.stores << " stored (" << (memory_bytes >> 20)
+         << " MB in memory)" << endl;
+}
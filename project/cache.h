@@ -0,0 +1,44 @@
+//
+//  cache.h
+//  opencv
+//
+//  content-addressed cache of stage outputs (decoded image, edge map, segments), for
+//  parameter sweeps that run the same images again and again: each output is keyed by
+//  a hash of its input plus the parameters of the stages that made it, so a run only
+//  recomputes the stages downstream of the parameter that changed
+//
+//  entries live in memory (up to CACHE_MEMORY bytes, oldest dropped first) and, with a
+//  cache directory, also on disk as one raw file per entry, memory-mapped when read;
+//  the disk cache is what carries results from one build/run of a sweep to the next
+
+#ifndef opencv_cache_h
+#define opencv_cache_h
+
+#include "project.h"
+#include <stdint.h>
+
+typedef uint64_t cache_key;
+
+const cache_key CACHE_SEED = 14695981039346656037ULL;      // FNV-1a offset basis
+const size_t CACHE_MEMORY = 512 << 20;      // bytes of entries kept in memory
+#define CACHE_MAGIC     0x31435453          // "STC1", first word of a cache file
+
+struct cache_stats {
+    long memory_hits, disk_hits, misses;
+    long stores;
+};
+
+void enable_stage_cache(const char *);      // directory for the disk cache, NULL = memory only
+bool stage_cache_enabled();
+
+cache_key hash_bytes(const void *, size_t, cache_key);     // FNV-1a style, 8 bytes at a time
+cache_key hash_mat(const Mat &, cache_key);                 // pixels + size + type
+cache_key hash_params(const char *, const double *, int, cache_key);   // stage name + parameter values
+cache_key hash_file(const string &);                        // file contents, 0 if it can't be read
+
+bool cache_get(cache_key, Mat &);           // copy of the entry (memory, then disk), false on a miss
+void cache_put(cache_key, const Mat &);     // continuous 2D Mats only
+void get_cache_stats(cache_stats *);
+void print_cache_stats();
+
+#endif
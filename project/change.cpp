@@ -0,0 +1,59 @@
+//
+//  change.cpp
+//  opencv
+//
+
+#include "change.h"
+
+void init_change_detector(change_detector *cd)
+{
+    cd->thumb.release();
+    cd->key.release();
+    cd->since_key = 0;
+    cd->frames = 0;
+    cd->skipped = 0;
+}
+
+// decides if a grayscale frame is different enough from the last processed one
+//  comparing against the last *processed* frame (not the previous frame) means
+//  slow drift still adds up to a change eventually
+bool frame_changed(change_detector *cd, const Mat &gray)
+{
+    cd->frames++;
+    // INTER_AREA averages every source pixel, so sensor noise mostly cancels out
+    resize(gray, cd->thumb, Size(THUMB_WIDTH, THUMB_HEIGHT), 0, 0, INTER_AREA);
+    
+    if (!cd->key.empty() && cd->since_key < CHANGE_MAX_SKIP &&
+        changed_blocks(cd->thumb, cd->key) < CHANGE_MIN_BLOCKS) {
+        cd->since_key++;
+        cd->skipped++;
+        return false;
+    }
+    
+    cd->thumb.copyTo(cd->key);
+    cd->since_key = 0;
+    return true;
+}
+
+// counts blocks of CHANGE_BLOCK x CHANGE_BLOCK px whose sum of absolute differences
+// is above CHANGE_BLOCK_SAD per pixel
+int changed_blocks(const Mat &a, const Mat &b)
+{
+    const int limit = CHANGE_BLOCK_SAD * CHANGE_BLOCK * CHANGE_BLOCK;
+    int changed = 0;
+    
+    for (int by = 0; by + CHANGE_BLOCK <= a.rows; by += CHANGE_BLOCK) {
+        for (int bx = 0; bx + CHANGE_BLOCK <= a.cols; bx += CHANGE_BLOCK) {
+            int sad = 0;
+            for (int y = by; y < by + CHANGE_BLOCK; y++) {
+                const uchar *pa = a.ptr<uchar>(y) + bx;
+                const uchar *pb = b.ptr<uchar>(y) + bx;
+                for (int x = 0; x < CHANGE_BLOCK; x++)
+                    sad += abs(pa[x] - pb[x]);
+            }
+            if (sad > limit)
+                changed++;
+        }
+    }
+    return changed;
+}
@@ -0,0 +1,33 @@
+//
+//  change.h
+//  opencv
+//
+//  cheap scene-change detection, to skip frames from a stationary camera:
+//  frames are shrunk to a small luma thumbnail and compared block by block
+//  (sum of absolute differences) with the last frame that was processed
+
+#ifndef opencv_change_h
+#define opencv_change_h
+
+#include "project.h"
+
+const int THUMB_WIDTH = 64;                 // size of the thumbnail compared (in px)
+const int THUMB_HEIGHT = 48;
+const int CHANGE_BLOCK = 8;                 // block size in the thumbnail (in px)
+const int CHANGE_BLOCK_SAD = 8;             // mean abs. difference (per px) for a block to have "changed"
+const int CHANGE_MIN_BLOCKS = 2;            // changed blocks needed for the frame to have changed
+const int CHANGE_MAX_SKIP = 30;             // force a full frame after this many skipped frames
+
+struct change_detector {
+    Mat thumb;                              // thumbnail of the current frame
+    Mat key;                                // thumbnail of the last frame processed in full
+    int since_key;                          // frames skipped since key
+    int frames;                             // frames seen
+    int skipped;                            // frames skipped
+};
+
+void init_change_detector(change_detector *);
+bool frame_changed(change_detector *, const Mat &);    // false if the frame can reuse the last result
+int changed_blocks(const Mat &, const Mat &);          // blocks whose SAD is above CHANGE_BLOCK_SAD
+
+#endif
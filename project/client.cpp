@@ -0,0 +1,271 @@
+//
+//  client.cpp
+//  opencv
+//
+//  small client for the lane-detection daemon (opencv -d):
+//  sends image paths, or raw frames through shared memory, prints the lane lines,
+//  and can benchmark requests/s against running one opencv process per image;
+//  with -E it listens for lane-departure events instead (opencv -E)
+
+#include "project.h"
+#include "daemon.h"
+#include "departure.h"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <cstdio>
+
+// program run once per image for the process-per-image side of the benchmark
+#define OPENCV_BINARY   "./opencv"
+
+// a frame the client shares with the daemon
+struct shared_frame {
+    char name[64];
+    void *data;
+    size_t bytes;
+};
+
+int connect_daemon(const char *path)
+{
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    if (connect(fd, (sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// sends one request and waits for its response
+bool request(int fd, const lane_request *req, lane_response *resp)
+{
+    if (write(fd, req, sizeof(*req)) != (ssize_t)sizeof(*req))
+        return false;
+    char *p = (char *)resp;
+    size_t n = sizeof(*resp);
+    while (n > 0) {
+        ssize_t r = read(fd, p, n);
+        if (r <= 0)
+            return false;
+        p += r;
+        n -= r;
+    }
+    return true;
+}
+
+// decodes an image in the client and copies it into a shared memory object
+bool share_frame(const char *file, shared_frame *shm, lane_request *req)
+{
+    Mat src = imread(file, IMREAD_GRAYSCALE);
+    if (src.empty())
+        return false;
+    size_t bytes = src.total();
+    if (shm->data == NULL || shm->bytes != bytes) {
+        if (shm->data != NULL)
+            munmap(shm->data, shm->bytes);
+        shm->data = NULL;
+        int fd = shm_open(shm->name, O_CREAT | O_RDWR, 0600);
+        if (fd < 0)
+            return false;
+        if (ftruncate(fd, bytes) < 0) {
+            close(fd);
+            return false;
+        }
+        shm->data = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (shm->data == MAP_FAILED) {
+            shm->data = NULL;
+            return false;
+        }
+        shm->bytes = bytes;
+    }
+    for (int y = 0; y < src.rows; y++)
+        memcpy((uchar *)shm->data + (size_t)y * src.cols, src.ptr<uchar>(y), src.cols);
+    req->type = REQ_FRAME;
+    req->width = src.cols;
+    req->height = src.rows;
+    strncpy(req->path, shm->name, MAX_PATH_LEN - 1);
+    return true;
+}
+
+// binds the event socket and prints lane-departure events as they arrive, with the time
+// from frame capture to here (both processes read CLOCK_MONOTONIC), until interrupted
+int listen_events(const char *path)
+{
+    static const char *names[] = { "none", "depart left", "depart right", "return" };
+    int fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    unlink(path);
+    if (fd < 0 || bind(fd, (sockaddr *)&addr, sizeof(addr)) < 0) {
+        cout << "cannot listen on " << path << ": " << strerror(errno) << endl;
+        return -1;
+    }
+    cout << "listening for events on " << path << endl;
+    
+    lane_event ev;
+    for (;;) {
+        ssize_t n = recv(fd, &ev, sizeof(ev), 0);
+        double received = now();
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            break;
+        if (n != (ssize_t)sizeof(ev) || ev.magic != EVENT_MAGIC || ev.type > EVENT_RETURN)
+            continue;
+        printf("frame %5u  %-12s  offset %+.2f  heading %+.3f  capture to event %.2f ms, to here %.2f ms\n",
+               ev.frame, names[ev.type], ev.offset, ev.heading, 1000 * (ev.sent - ev.captured),
+               1000 * (received - ev.captured));
+        fflush(stdout);
+    }
+    close(fd);
+    unlink(path);
+    return 0;
+}
+
+// runs the standalone binary once on an image, output discarded; without overlay it is
+// run with -n (detection only, as a daemon request without -o)
+bool run_process(const char *file, bool overlay)
+{
+    pid_t pid = fork();
+    if (pid < 0)
+        return false;
+    if (pid == 0) {
+        int null = open("/dev/null", O_WRONLY);
+        dup2(null, STDOUT_FILENO);
+        if (overlay)
+            execl(OPENCV_BINARY, OPENCV_BINARY, file, (char *)NULL);
+        else
+            execl(OPENCV_BINARY, OPENCV_BINARY, "-n", file, (char *)NULL);
+        _exit(127);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+void usage(const char *prog)
+{
+    cout << "usage: " << prog << " [-S socket] [-f] [-o overlay.png] [-B n] image ..." << endl;
+    cout << "       " << prog << " -E socket" << endl;
+    cout << "  -S: daemon socket (default " << DEFAULT_SOCKET << ")" << endl;
+    cout << "  -f: decode here and pass raw frames through shared memory (default: send the path)" << endl;
+    cout << "  -o: have the daemon write the overlay image too" << endl;
+    cout << "  -B: send each image n times, then run " << OPENCV_BINARY
+         << " n times per image (with -n unless -o), and compare requests/s" << endl;
+    cout << "  -E: print the lane-departure events opencv -E sends to this socket (e.g. "
+         << DEFAULT_EVENT_SOCKET << ")" << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *socket_path = DEFAULT_SOCKET;
+    const char *overlay = NULL;
+    const char *event_path = NULL;
+    bool raw = false;
+    int bench = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "S:fo:B:E:")) != -1) {
+        switch (opt) {
+            case 'S': socket_path = optarg; break;
+            case 'f': raw = true; break;
+            case 'o': overlay = optarg; break;
+            case 'B': bench = atoi(optarg); break;
+            case 'E': event_path = optarg; break;
+            default:
+                usage(argv[0]);
+                return -1;
+        }
+    }
+    if (event_path != NULL)
+        return listen_events(event_path);
+    if (optind >= argc) {
+        usage(argv[0]);
+        return -1;
+    }
+    
+    int fd = connect_daemon(socket_path);
+    if (fd < 0) {
+        cout << "cannot connect to " << socket_path << ": " << strerror(errno) << endl;
+        return -1;
+    }
+    
+    shared_frame shm;
+    snprintf(shm.name, sizeof(shm.name), "/lanes-%d", (int)getpid());
+    shm.data = NULL;
+    shm.bytes = 0;
+    
+    int repeat = bench > 0 ? bench : 1;
+    long requests = 0;
+    double start = now();
+    for (int i = optind; i < argc; i++) {
+        lane_request req;
+        lane_response resp;
+        memset(&req, 0, sizeof(req));
+        resp.status = -1;
+        req.magic = LANE_MAGIC;
+        req.type = REQ_FILE;
+        strncpy(req.path, argv[i], MAX_PATH_LEN - 1);
+        if (overlay != NULL) {
+            req.flags |= REQ_OVERLAY;
+            strncpy(req.overlay, overlay, MAX_PATH_LEN - 1);
+        }
+        
+        for (int r = 0; r < repeat; r++) {
+            if (raw && !share_frame(argv[i], &shm, &req)) {
+                cout << "cannot share " << argv[i] << endl;
+                break;
+            }
+            if (!request(fd, &req, &resp)) {
+                cout << "daemon closed the connection" << endl;
+                close(fd);
+                return -1;
+            }
+            requests++;
+        }
+        if (bench > 0)
+            continue;
+        
+        if (resp.status != 0) {
+            cout << argv[i] << ": failed" << endl;
+            continue;
+        }
+        cout << argv[i] << ": " << resp.num_lines << " lines (" << resp.detect_time * 1000 << " ms)" << endl;
+        for (uint32_t l = 0; l < resp.num_lines; l++)
+            cout << "  (" << resp.lines[l][0] << "," << resp.lines[l][1] << ") ("
+                 << resp.lines[l][2] << "," << resp.lines[l][3] << ")" << endl;
+    }
+    double daemon_time = now() - start;
+    close(fd);
+    if (shm.data != NULL) {
+        munmap(shm.data, shm.bytes);
+        shm_unlink(shm.name);
+    }
+    
+    if (bench > 0) {
+        start = now();
+        long runs = 0;
+        for (int i = optind; i < argc; i++)
+            for (int r = 0; r < bench; r++)
+                runs += run_process(argv[i], overlay != NULL);
+        double process_time = now() - start;
+        
+        printf("%s, both sides\n", overlay != NULL ? "detection + overlay image" : "detection only (process: -n)");
+        printf("daemon (%s):      %6ld requests  %8.1f req/s\n", raw ? "shm frames" : "file paths",
+               requests, requests / daemon_time);
+        printf("process per image:  %6ld runs      %8.1f req/s\n", runs, runs / process_time);
+    }
+    return 0;
+}
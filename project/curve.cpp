@@ -0,0 +1,237 @@
+//
+//  curve.cpp
+//  opencv
+//
+
+#include "curve.h"
+
+static double to_t(const lane_curve *c, double y)
+{
+    return (c->height - 1 - y) / c->height;
+}
+
+static double to_y(const lane_curve *c, double t)
+{
+    return c->height - 1 - t * c->height;
+}
+
+double curve_x(const lane_curve *c, double y)
+{
+    double t = to_t(c, y);
+    return c->coef[0] + c->coef[1] * t + c->coef[2] * t * t;
+}
+
+static double det3(double a, double b, double c, double d, double e, double f, double g, double h, double i)
+{
+    return a*(e*i - f*h) - b*(d*i - f*g) + c*(d*h - e*g);
+}
+
+// solves the normal equations
+//  | S0 S1 S2      |   | c0 |   | X0 |
+//  | S1 S2 S3      | x | c1 | = | X1 |     Sk = sum w t^k, Xk = sum w x t^k
+//  | S2 S3 S4 + r  |   | c2 |   | X2 |     r = CURVE_RIDGE x S0
+// by Cramer's rule; falls back to a straight line, then to a vertical one, if the points
+// don't span enough rows to fix the higher terms
+static void solve_curve(lane_curve *c)
+{
+    const double *s = c->sum_t, *x = c->sum_xt;
+    double r = CURVE_RIDGE * s[0];
+    double d = det3(s[0], s[1], s[2], s[1], s[2], s[3], s[2], s[3], s[4] + r);
+    if (abs(d) > 1e-12 * s[0] * s[0] * s[0]) {
+        c->coef[0] = det3(x[0], s[1], s[2], x[1], s[2], s[3], x[2], s[3], s[4] + r) / d;
+        c->coef[1] = det3(s[0], x[0], s[2], s[1], x[1], s[3], s[2], x[2], s[4] + r) / d;
+        c->coef[2] = det3(s[0], s[1], x[0], s[1], s[2], x[1], s[2], s[3], x[2]) / d;
+        return;
+    }
+    d = s[0]*s[2] - s[1]*s[1];
+    if (abs(d) > 1e-12 * s[0] * s[0]) {
+        c->coef[0] = (x[0]*s[2] - x[1]*s[1]) / d;
+        c->coef[1] = (s[0]*x[1] - s[1]*x[0]) / d;
+    }
+    else {
+        c->coef[0] = x[0] / s[0];
+        c->coef[1] = 0;
+    }
+    c->coef[2] = 0;
+}
+
+static void add_point(lane_curve *c, double x, double y, double w)
+{
+    double t = to_t(c, y), tk = 1;
+    for (int k = 0; k < 5; k++, tk *= t) {
+        c->sum_t[k] += w * tk;
+        if (k < 3)
+            c->sum_xt[k] += w * x * tk;
+    }
+    if (!c->hit) {                          // first point this frame: cover only this frame's rows
+        c->t_min = c->t_max = t;
+        c->hit = true;
+    }
+    c->t_min = min(c->t_min, t);
+    c->t_max = max(c->t_max, t);
+}
+
+// a segment counts as its two ends and its middle, a third of its length each
+static void add_segment(lane_curve *c, Vec4i l)
+{
+    double w = norm(Point(l[X2] - l[X1], l[Y2] - l[Y1])) / 3;
+    add_point(c, l[X1], l[Y1], w);
+    add_point(c, (l[X1] + l[X2]) / 2.0, (l[Y1] + l[Y2]) / 2.0, w);
+    add_point(c, l[X2], l[Y2], w);
+    solve_curve(c);
+}
+
+static lane_curve new_curve(int height)
+{
+    lane_curve c = lane_curve();            // all sums zero
+    c.height = height;
+    return c;
+}
+
+// the lighter lane's curve lies within tol of the heavier one's at both ends of its rows
+static bool same_curve(const lane_curve *a, const lane_curve *b, double tol)
+{
+    if (a->sum_t[0] < b->sum_t[0])
+        swap(a, b);
+    for (int k = 0; k < 2; k++) {
+        double y = to_y(b, k ? b->t_max : b->t_min);
+        if (abs(curve_x(a, y) - curve_x(b, y)) > tol)
+            return false;
+    }
+    return true;
+}
+
+// the normal equations of the union of two point sets are the sums of theirs
+static void merge_curves(lane_curve *a, const lane_curve *b)
+{
+    for (int k = 0; k < 5; k++)
+        a->sum_t[k] += b->sum_t[k];
+    for (int k = 0; k < 3; k++)
+        a->sum_xt[k] += b->sum_xt[k];
+    if (b->hit && a->hit) {
+        a->t_min = min(a->t_min, b->t_min);
+        a->t_max = max(a->t_max, b->t_max);
+    }
+    else if (b->hit) {
+        a->t_min = b->t_min;
+        a->t_max = b->t_max;
+    }
+    a->hit = a->hit || b->hit;
+    a->misses = min(a->misses, b->misses);
+    solve_curve(a);
+}
+
+static void sample_path(lane_curve *c)
+{
+    for (int k = 0; k < CURVE_SAMPLES; k++) {
+        double y = to_y(c, c->t_max * k / (CURVE_SAMPLES - 1));
+        c->path[k] = Point(cvRound(curve_x(c, y)), cvRound(y));
+    }
+}
+
+// ------------------------
+
+static bool lower_end_first(Vec4i l1, Vec4i l2)
+{
+    return l1[Y1] > l2[Y1];
+}
+
+// segments are taken bottom up (the nearest are the most reliable), each added to the lane
+// whose curve passes closest to its lower end, within CURVE_GATE, or else starting a new
+// lane; lanes that turn out to be the same line (within CURVE_MERGE) are merged, and lanes
+// without segments for CURVE_MAX_MISSES frames dropped
+void fit_curves(const vector<Vec4i> &segments, Size size, vector<lane_curve> *curves)
+{
+    if (!curves->empty() && (*curves)[0].height != size.height)
+        curves->clear();
+    for (size_t i = 0; i < curves->size(); i++) {
+        lane_curve *c = &(*curves)[i];
+        for (int k = 0; k < 5; k++)
+            c->sum_t[k] *= CURVE_FORGET;
+        for (int k = 0; k < 3; k++)
+            c->sum_xt[k] *= CURVE_FORGET;
+        c->hit = false;
+    }
+    
+    // lower end first in each segment, segments ordered by their lower end, bottom first
+    vector<Vec4i> lines(segments);
+    for (size_t i = 0; i < lines.size(); i++)
+        if (lines[i][Y1] < lines[i][Y2])
+            lines[i] = Vec4i(lines[i][X2], lines[i][Y2], lines[i][X1], lines[i][Y1]);
+    sort(lines.begin(), lines.end(), lower_end_first);
+    
+    double gate = CURVE_GATE * size.width;
+    for (size_t i = 0; i < lines.size(); i++) {
+        Vec4i l = lines[i];
+        int best = -1;
+        double best_d = gate;
+        for (size_t j = 0; j < curves->size(); j++) {
+            double d = abs(curve_x(&(*curves)[j], l[Y1]) - l[X1]);
+            if (d < best_d) {
+                best = (int)j;
+                best_d = d;
+            }
+        }
+        if (best < 0) {
+            curves->push_back(new_curve(size.height));
+            best = (int)curves->size() - 1;
+        }
+        add_segment(&(*curves)[best], l);
+    }
+    
+    for (size_t i = 0; i < curves->size(); i++)
+        for (size_t j = i + 1; j < curves->size(); j++)
+            if (same_curve(&(*curves)[i], &(*curves)[j], CURVE_MERGE * size.width)) {
+                merge_curves(&(*curves)[i], &(*curves)[j]);
+                curves->erase(curves->begin() + j--);
+            }
+    
+    for (size_t i = 0; i < curves->size(); i++) {
+        lane_curve *c = &(*curves)[i];
+        c->misses = c->hit ? 0 : c->misses + 1;
+        if (c->misses > CURVE_MAX_MISSES)
+            curves->erase(curves->begin() + i--);
+        else
+            sample_path(c);
+    }
+}
+
+void curve_lines(const vector<lane_curve> &curves, vector<Vec4i> *lines)
+{
+    lines->clear();
+    for (size_t i = 0; i < curves.size(); i++) {
+        if (curves[i].sum_t[0] < CURVE_MIN_LENGTH)
+            continue;
+        const Point *p = curves[i].path;
+        lines->push_back(Vec4i(p[0].x, p[0].y, p[CURVE_SAMPLES-1].x, p[CURVE_SAMPLES-1].y));
+    }
+}
+
+// each index line is the chord of one output lane (curve_lines); the paths are left
+// empty if any line isn't
+void index_paths(lane_index *index, const vector<lane_curve> &curves)
+{
+    index->paths.clear();
+    for (size_t i = 0; i < index->lines.size(); i++) {
+        Vec4i l = index->lines[i];
+        size_t j = 0;
+        for (; j < curves.size(); j++) {
+            const Point *p = curves[j].path;
+            if (curves[j].sum_t[0] >= CURVE_MIN_LENGTH && p[0] == Point(l[X1], l[Y1]) &&
+                p[CURVE_SAMPLES-1] == Point(l[X2], l[Y2]))
+                break;
+        }
+        if (j == curves.size()) {
+            index->paths.clear();
+            return;
+        }
+        index->paths.insert(index->paths.end(), curves[j].path, curves[j].path + CURVE_SAMPLES);
+    }
+}
+
+void scale_curves(vector<lane_curve> *curves, int scale)
+{
+    for (size_t i = 0; i < curves->size(); i++)
+        for (int k = 0; k < CURVE_SAMPLES; k++)
+            (*curves)[i].path[k] *= scale;
+}
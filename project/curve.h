@@ -0,0 +1,46 @@
+//
+//  curve.h
+//  opencv
+//
+//  curved lane model: each lane line is x = c0 + c1 t + c2 t^2, t = (height-1 - y) / height
+//  (0 at the bottom row), fitted by least squares from the points of its segments
+//
+//  a lane keeps only the sums of its normal equations (fixed size), so adding a segment
+//  or merging two lanes is a few additions, and the fit carries over to the next frame:
+//  the sums are scaled by CURVE_FORGET and the new frame's points added on top
+
+#ifndef opencv_curve_h
+#define opencv_curve_h
+
+#include "project.h"
+
+const int CURVE_SAMPLES = 16;               // points of each output polyline, bottom to top
+const double CURVE_GATE = 0.03;             // how close (fraction of width) a segment's lower end must be
+                                            //  to a lane's curve to be added to it
+const double CURVE_MERGE = 0.05;            // how close (fraction of width) two lanes' curves must stay to be
+                                            //  merged (e.g. the two edges of a wide painted line)
+const double CURVE_RIDGE = 1e-5;            // pull towards straight lines (x total length), so a lane seen
+                                            //  over a few rows doesn't bend wildly
+const double CURVE_FORGET = 0.5;            // share of the last frames' weight a lane keeps per frame
+const int CURVE_MAX_MISSES = 5;             // frames a lane is kept without new segments
+const double CURVE_MIN_LENGTH = 2 * HLINES_MINLINE; // weight (segment length, px) a lane needs to be output;
+                                            //  with CURVE_FORGET a strong lane coasts over a frame or two
+
+struct lane_curve {
+    double sum_t[5];                        // sum of w t^k, k = 0..4 (w = segment length per point)
+    double sum_xt[3];                       // sum of w x t^k, k = 0..2
+    double coef[3];                         // c0, c1, c2
+    int height;                             // rows of the frames it is fitted on (t = 0 at height-1)
+    double t_min, t_max;                    // rows the points cover (as t)
+    int misses;                             // frames in a row without new segments
+    bool hit;                               // got segments this frame
+    Point path[CURVE_SAMPLES];              // sampled from the bottom row to t_max
+};
+
+void fit_curves(const vector<Vec4i> &, Size, vector<lane_curve> *);    // one frame: update/add/merge/drop lanes
+void curve_lines(const vector<lane_curve> &, vector<Vec4i> *);         // output lanes as bottom-to-top chords
+void index_paths(lane_index *, const vector<lane_curve> &);             // paths of the index lines (see lane_index)
+void scale_curves(vector<lane_curve> *, int);                           // output paths x scale (fit unchanged)
+double curve_x(const lane_curve *, double);                             // x of a lane's curve at a row y
+
+#endif
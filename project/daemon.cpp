@@ -0,0 +1,203 @@
+//
+//  daemon.cpp
+//  opencv
+//
+
+#include "daemon.h"
+#include "engine.h"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <cerrno>
+#include <cstring>
+
+static volatile sig_atomic_t stopping = 0;
+
+static void on_signal(int)
+{
+    stopping = 1;
+}
+
+// last shared memory frame mapped; a client normally reuses one object for every frame
+struct shm_frame {
+    string name;
+    size_t bytes;
+    void *data;
+    int fd;                                 // kept open to check the object's size on every request
+};
+
+// unmaps the last frame and closes its object
+static void unmap_frame(shm_frame *shm)
+{
+    if (shm->data != NULL)
+        munmap(shm->data, shm->bytes);
+    if (shm->fd >= 0)
+        close(shm->fd);
+    shm->data = NULL;
+    shm->fd = -1;
+}
+
+// reads/writes exactly n bytes (sockets may return partial counts)
+static bool read_all(int fd, void *buf, size_t n)
+{
+    char *p = (char *)buf;
+    while (n > 0) {
+        ssize_t r = read(fd, p, n);
+        if (r < 0 && errno == EINTR && !stopping)
+            continue;
+        if (r <= 0)
+            return false;
+        p += r;
+        n -= r;
+    }
+    return true;
+}
+
+static bool write_all(int fd, const void *buf, size_t n)
+{
+    const char *p = (const char *)buf;
+    while (n > 0) {
+        ssize_t r = write(fd, p, n);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r <= 0)
+            return false;
+        p += r;
+        n -= r;
+    }
+    return true;
+}
+
+// maps a client's shared memory frame (read-only), reusing the last mapping if it's the same
+//  the object must hold the whole frame: reading past its end would raise SIGBUS and take
+//  the daemon down for every client, so its size is checked on every request (a client
+//  may shrink it after the first one)
+static bool map_frame(shm_frame *shm, const lane_request *req, Mat &frame)
+{
+    if (req->width == 0 || req->height == 0 || req->width > MAX_FRAME_SIDE || req->height > MAX_FRAME_SIDE)
+        return false;
+    size_t bytes = (size_t)req->width * req->height;
+    string name(req->path, strnlen(req->path, MAX_PATH_LEN));
+    if (shm->data == NULL || shm->name != name || shm->bytes != bytes) {
+        unmap_frame(shm);
+        int fd = shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd < 0)
+            return false;
+        void *p = mmap(NULL, bytes, PROT_READ, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED) {
+            close(fd);
+            return false;
+        }
+        shm->name = name;
+        shm->bytes = bytes;
+        shm->data = p;
+        shm->fd = fd;
+    }
+    struct stat st;
+    if (fstat(shm->fd, &st) < 0 || (size_t)st.st_size < bytes) {
+        unmap_frame(shm);
+        return false;
+    }
+    // wraps the client's pixels, no copy
+    frame = Mat(req->height, req->width, CV_8UC1, shm->data);
+    return true;
+}
+
+// answers one request with the detector kept from earlier requests
+static void handle_request(detector *det, shm_frame *shm, const lane_request *req, lane_response *resp)
+{
+    memset(resp, 0, sizeof(*resp));
+    resp->status = -1;
+    if (req->magic != LANE_MAGIC)
+        return;
+    
+    double start = now();
+    Mat src;
+    if (req->type == REQ_FILE)
+        src = imread(string(req->path, strnlen(req->path, MAX_PATH_LEN)), IMREAD_GRAYSCALE);
+    else if (req->type == REQ_FRAME)
+        map_frame(shm, req, src);
+    if (src.empty())
+        return;
+    
+    run_detector(det, src);
+    
+    if (req->flags & REQ_OVERLAY) {
+        vector<int> compression_params;
+        compression_params.push_back(IMWRITE_PNG_COMPRESSION);
+        compression_params.push_back(9);    // 0-9 for png quality
+        imwrite(string(req->overlay, strnlen(req->overlay, MAX_PATH_LEN)), draw_result(src, det),
+                compression_params);
+    }
+    
+    resp->num_lines = min((size_t)MAX_RESPONSE_LINES, det->index.lines.size());
+    for (uint32_t i = 0; i < resp->num_lines; i++)
+        for (int k = 0; k < 4; k++)
+            resp->lines[i][k] = det->index.lines[i][k];
+    resp->detect_time = now() - start;
+    resp->status = 0;
+}
+
+// serves clients one at a time until SIGINT/SIGTERM
+//  a connection may carry any number of requests; the detector (and its
+//  lookup tables and buffers) stays warm across all of them
+int run_daemon(const char *path, const lane_engine *engine)
+{
+    int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server < 0) {
+        cout << "cannot create socket: " << strerror(errno) << endl;
+        return -1;
+    }
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    unlink(path);
+    if (bind(server, (sockaddr *)&addr, sizeof(addr)) < 0 || listen(server, 8) < 0) {
+        cout << "cannot listen on " << path << ": " << strerror(errno) << endl;
+        close(server);
+        return -1;
+    }
+    
+    // no SA_RESTART: accept()/read() return EINTR so the loop sees the signal
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+    
+    detector det;
+    init_detector(&det, engine);
+    shm_frame shm;
+    shm.bytes = 0;
+    shm.data = NULL;
+    shm.fd = -1;
+    long served = 0;
+    
+    cout << "listening on " << path << " (" << engine->name << ")" << endl;
+    while (!stopping) {
+        int client = accept(server, NULL, NULL);
+        if (client < 0)
+            continue;
+        lane_request req;
+        lane_response resp;
+        while (!stopping && read_all(client, &req, sizeof(req))) {
+            handle_request(&det, &shm, &req, &resp);
+            if (!write_all(client, &resp, sizeof(resp)))
+                break;
+            served++;
+        }
+        close(client);
+    }
+    
+    unmap_frame(&shm);
+    close(server);
+    unlink(path);
+    cout << "served " << served << " requests" << endl;
+    return 0;
+}
@@ -0,0 +1,52 @@
+//
+//  daemon.h
+//  opencv
+//
+//  resident lane-detection daemon on a local (Unix domain) socket, so tools
+//  that detect lanes image by image don't pay for process startup, dynamic
+//  linking and first-touch allocations on every image
+//
+//  protocol: the client sends fixed-size lane_request records and gets one
+//  lane_response back for each, on the same connection, in order
+
+#ifndef opencv_daemon_h
+#define opencv_daemon_h
+
+#include <stdint.h>
+
+#define DEFAULT_SOCKET      "/tmp/lanes.sock"
+#define LANE_MAGIC          0x4c414e45      // "LANE"
+
+const int MAX_PATH_LEN = 256;
+const uint32_t MAX_FRAME_SIDE = 16384;      // largest REQ_FRAME width/height accepted
+const int MAX_RESPONSE_LINES = 16;          // lane lines returned (extra lines are dropped)
+
+// request types
+enum {
+    REQ_FILE = 1,                           // path: image file to read
+    REQ_FRAME = 2                           // path: POSIX shared memory object holding a width*height grayscale frame
+};
+
+// request flags
+const uint32_t REQ_OVERLAY = 1;             // also write the overlay as a .png to overlay
+
+struct lane_request {
+    uint32_t magic;
+    uint32_t type;
+    uint32_t flags;
+    uint32_t width, height;                 // REQ_FRAME only
+    char path[MAX_PATH_LEN];
+    char overlay[MAX_PATH_LEN];
+};
+
+struct lane_response {
+    int32_t status;                         // 0 = ok, -1 = error
+    uint32_t num_lines;
+    int32_t lines[MAX_RESPONSE_LINES][4];   // x1,y1,x2,y2 in image coordinates, left to right
+    double detect_time;                     // time spent detecting (s), without reading the request
+};
+
+struct lane_engine;
+int run_daemon(const char *, const lane_engine *);  // serves requests on the socket until SIGINT/SIGTERM
+
+#endif
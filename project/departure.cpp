@@ -0,0 +1,100 @@
+//
+//  departure.cpp
+//  opencv
+//
+
+#include "departure.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+bool open_departure(departure_state *d, const char *path)
+{
+    d->side = 0;
+    d->events = d->dropped = 0;
+    d->latency.clear();
+    d->latency.reserve(DEPART_LATENCY_FRAMES);
+    d->frames = 0;
+    memset(&d->addr, 0, sizeof(d->addr));
+    d->addr.sun_family = AF_UNIX;
+    strncpy(d->addr.sun_path, path, sizeof(d->addr.sun_path) - 1);
+    d->fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if (d->fd < 0)
+        return false;
+    fcntl(d->fd, F_SETFL, fcntl(d->fd, F_GETFL) | O_NONBLOCK);
+    return true;
+}
+
+void close_departure(departure_state *d)
+{
+    if (d->fd >= 0)
+        close(d->fd);
+    d->fd = -1;
+}
+
+// offset: the car is the frame's centre column (as in build_lane_index); heading: where
+// the lane's two lines meet, against the centre column (lines that don't meet: 0)
+bool lane_position(const lane_index *index, Size size, double *offset, double *heading)
+{
+    if (num_lanes(index) == 0)
+        return false;
+    int own = index->own_lane;
+    double left = index->bottom_x[own], right = index->bottom_x[own + 1];
+    double car_x = size.width / 2.0;
+    *offset = (car_x - (left + right) / 2) / max(right - left, 1.0);
+    
+    // x = bottom_x + s (bottom - y) for each line; they meet (bottom - y) = dx / ds higher up
+    Vec4i l = index->lines[own], r = index->lines[own + 1];
+    double sl = (l[X1] - l[X2]) / (double)(l[Y2] - l[Y1]), sr = (r[X1] - r[X2]) / (double)(r[Y2] - r[Y1]);
+    *heading = 0;
+    if (l[Y1] != l[Y2] && r[Y1] != r[Y2] && abs(sl - sr) > 1e-6) {
+        double up = (right - left) / (sl - sr);
+        *heading = (car_x - (left + sl * up)) / size.width;
+    }
+    return true;
+}
+
+static void send_event(departure_state *d, int type, int frame, double offset, double heading, double captured)
+{
+    lane_event ev;
+    ev.magic = EVENT_MAGIC;
+    ev.type = type;
+    ev.frame = frame;
+    ev.offset = (float)offset;
+    ev.heading = (float)heading;
+    ev.captured = captured;
+    ev.sent = now();
+    ssize_t n = sendto(d->fd, &ev, sizeof(ev), MSG_DONTWAIT, (sockaddr *)&d->addr, sizeof(d->addr));
+    if (n == (ssize_t)sizeof(ev))
+        d->events++;
+    else
+        d->dropped++;                       // ENOENT/ECONNREFUSED: nobody listening, EAGAIN: listener behind
+}
+
+// frames without a lane keep the last state (a departure stays a departure until the car
+// is seen back in the middle of a lane)
+int update_departure(departure_state *d, const lane_index *index, Size size, int frame, double captured)
+{
+    double offset, heading;
+    int type = EVENT_NONE;
+    if (lane_position(index, size, &offset, &heading)) {
+        if (d->side == 0 && abs(offset) > DEPART_ENTER) {
+            d->side = offset < 0 ? -1 : 1;
+            type = d->side < 0 ? EVENT_DEPART_LEFT : EVENT_DEPART_RIGHT;
+        }
+        else if (d->side != 0 && abs(offset) < DEPART_EXIT) {
+            d->side = 0;
+            type = EVENT_RETURN;
+        }
+        if (type != EVENT_NONE && d->fd >= 0)
+            send_event(d, type, frame, offset, heading, captured);
+    }
+    double latency = now() - captured;
+    if (d->latency.size() < (size_t)DEPART_LATENCY_FRAMES)
+        d->latency.push_back(latency);      // within the capacity reserved
+    else
+        d->latency[d->frames % DEPART_LATENCY_FRAMES] = latency;
+    d->frames++;
+    return type;
+}
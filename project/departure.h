@@ -0,0 +1,69 @@
+//
+//  departure.h
+//  opencv
+//
+//  lane-departure events: where the car sits in its lane at the bottom row (offset) and
+//  how it points relative to the lane (heading), taken from the lane index right after
+//  the model stage, and a datagram on a local socket whenever the car leaves or comes
+//  back to the middle of its lane - before any drawing or encoding of the frame
+//
+//  the departure/return thresholds are apart (hysteresis), so a car driving near a
+//  threshold doesn't send an event every frame; events are fire-and-forget: with no
+//  listener bound to the socket they are dropped (and counted), never waited for
+
+#ifndef opencv_departure_h
+#define opencv_departure_h
+
+#include "project.h"
+#include <stdint.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define DEFAULT_EVENT_SOCKET    "/tmp/lane_events.sock"
+#define EVENT_MAGIC             0x5645444c  // "LDEV"
+
+const double DEPART_ENTER = 0.25;           // |offset| at which the car is leaving its lane (wheel
+                                            //  on the line, for a car half as wide as the lane)
+const double DEPART_EXIT = 0.15;            // |offset| below which it is back in the lane
+const int DEPART_LATENCY_FRAMES = 4096;     // latencies kept (the last frames'), allocated when opened
+
+// event types
+enum {
+    EVENT_NONE = 0,
+    EVENT_DEPART_LEFT = 1,
+    EVENT_DEPART_RIGHT = 2,
+    EVENT_RETURN = 3
+};
+
+// one datagram per event (host layout); times are now() values (CLOCK_MONOTONIC), so a
+// listener on the same machine can take its own latency from them
+struct lane_event {
+    uint32_t magic;
+    uint32_t type;
+    uint32_t frame;
+    float offset;                           // car (frame centre) from the lane centre, in lane widths, + = right
+    float heading;                          // lane's vanishing point from the frame centre, in frame widths,
+                                            //  + = car pointing right of the lane (0 = parallel)
+    double captured;                        // when the frame was captured (source.h)
+    double sent;                            // when the event was sent
+};
+
+struct departure_state {
+    int fd;                                 // datagram socket, -1 if not opened
+    sockaddr_un addr;                       // listener's address
+    int side;                               // 0 = in the lane, -1/+1 = departing left/right
+    long events, dropped;                   // sent / not delivered (no listener, buffer full)
+    vector<double> latency;                 // per detected frame: capture to event decision (s), a ring
+                                            //  of the last DEPART_LATENCY_FRAMES (no allocation per frame)
+    long frames;                            // latencies taken (latency[frames % DEPART_LATENCY_FRAMES] is next)
+};
+
+bool open_departure(departure_state *, const char *);  // false if the socket can't be created
+void close_departure(departure_state *);
+// offset and heading of the car in its lane (see lane_event); false if it has no lane
+bool lane_position(const lane_index *, Size, double *, double *);
+// one frame's lane index: updates the state and sends an event if it changed, returns the
+//  event type (EVENT_NONE if none); frame number, time the frame was captured
+int update_departure(departure_state *, const lane_index *, Size, int, double);
+
+#endif
@@ -0,0 +1,447 @@
+//
+//  engine.cpp
+//  opencv
+//
+
+#include "engine.h"
+
+// ===================================================================
+// registry - to add an engine, add a row (stages may be shared)
+// ===================================================================
+
+const lane_engine ENGINES[] = {
+    { "hough",      canny_edges,            hough_segments,         combine_model,          true,   false },
+    // the edge stage (re)builds the remap table the model stage needs, so it always has to run
+    { "birdseye",   birdseye_edge_stage,    birdseye_segment_stage, birdseye_model_stage,   false,  false },
+    // hough, voting only on edges next to white/yellow paint
+    { "paint",      paint_edges,            hough_segments,         combine_model,          true,   true },
+    // hough, merging only the segments that point at the vanishing point
+    { "vp",         canny_edges,            hough_segments,         vp_model,               true,   false },
+    // hough segments, fitted with curved lanes instead of combined and extended
+    { "curve",      canny_edges,            hough_segments,         curve_model,            true,   false },
+    // hough, stopping the segment stage when its time budget (-H) runs out; the segments
+    // then depend on the machine's speed, so they can't be cached
+    { "anytime",    canny_edges,            anytime_segments,       combine_model,          false,  false },
+    // segments grown from gradient regions (no Canny, no Hough), then combined as usual
+    { "lsd",        level_line_edges,       lsd_segments,           combine_model,          true,   false },
+};
+
+int num_engines()
+{
+    return sizeof(ENGINES) / sizeof(ENGINES[0]);
+}
+
+const lane_engine *get_engine(int i)
+{
+    return &ENGINES[i];
+}
+
+const lane_engine *find_engine(const char *name)
+{
+    for (int i = 0; i < num_engines(); i++)
+        if (strcmp(ENGINES[i].name, name) == 0)
+            return &ENGINES[i];
+    return NULL;
+}
+
+// ===================================================================
+// running a detector
+// ===================================================================
+
+void init_detector(detector *det, const lane_engine *engine)
+{
+    det->engine = engine;
+    det->size = Size(0, 0);
+    det->edge_time = det->segment_time = det->model_time = 0;
+    det->coverage = -1;
+    init_vanishing_point(&det->vp);
+}
+
+// compile-time parameters the edge and segment stages depend on, hashed into their
+// cache keys so a rebuild with other values doesn't reuse stale outputs
+static const double EDGE_PARAMS[] = { CANNY_T1, CANNY_T2, CANNY_APERTURE };
+static const double PAINT_PARAMS[] = { CANNY_T1, CANNY_T2, CANNY_APERTURE,
+                                       PAINT_CONTRAST, PAINT_FLOOR, WHITE_CHROMA, YELLOW_MARGIN, PAINT_DILATE };
+static const double SEGMENT_PARAMS[] = { HLINES_THRESH, HLINES_MINLINE, HLINES_MINGAP, HORIZONTAL_TOLERANCE };
+static const double LSD_PARAMS[] = { LSD_SIGMA, LSD_GRADIENT, LSD_TOLERANCE, LSD_DENSITY, LSD_MIN_PIXELS, LSD_MIN_LENGTH, LSD_SHRINK,
+                                     HORIZONTAL_TOLERANCE };
+
+#define PARAMS(p)   p, sizeof(p) / sizeof(double)
+
+// the cacheable stages, keyed by what they compute rather than by the engine running
+// them, so engines that share a stage (hough, vp and curve) share its cached outputs:
+// a name that is the same in every build (a function's address is not: -K keeps entries
+// on disk across builds) and the parameters the stage's output depends on
+struct cached_edge_stage {
+    edge_stage stage;
+    const char *name;
+    const double *params;
+    int num_params;
+};
+
+struct cached_segment_stage {
+    segment_stage stage;
+    const char *name;
+    const double *params;
+    int num_params;
+};
+
+static const cached_edge_stage CACHED_EDGE_STAGES[] = {
+    { canny_edges,          "canny",        PARAMS(EDGE_PARAMS) },
+    { paint_edges,          "paint",        PARAMS(PAINT_PARAMS) },
+    { level_line_edges,     "level_lines",  PARAMS(LSD_PARAMS) },
+};
+
+static const cached_segment_stage CACHED_SEGMENT_STAGES[] = {
+    { hough_segments,       "hough",        PARAMS(SEGMENT_PARAMS) },
+    { lsd_segments,         "lsd",          PARAMS(LSD_PARAMS) },
+};
+
+// edge stage, or its output from the cache if the same frame was seen with the same parameters
+//  returns the cache key of the edge map (0 if not cached: caching off, the engine keeps
+//  state in its stages, or the stage isn't in CACHED_EDGE_STAGES)
+static cache_key cached_edges(detector *det, const Mat &src)
+{
+    const cached_edge_stage *stage = NULL;
+    int n = sizeof(CACHED_EDGE_STAGES) / sizeof(CACHED_EDGE_STAGES[0]);
+    for (int i = 0; i < n && det->engine->cacheable && stage_cache_enabled(); i++)
+        if (CACHED_EDGE_STAGES[i].stage == det->engine->edges)
+            stage = &CACHED_EDGE_STAGES[i];
+    if (stage == NULL) {
+        det->engine->edges(det, src, det->edges);
+        return 0;
+    }
+    cache_key key = hash_mat(src, CACHE_SEED);
+    if (det->engine->colour && !det->colour.empty())
+        key = hash_mat(det->colour, key);
+    key = hash_params(stage->name, stage->params, stage->num_params, key);
+    if (!cache_get(key, det->edges)) {
+        det->engine->edges(det, src, det->edges);
+        cache_put(key, det->edges);
+    }
+    return key;
+}
+
+// segment stage, keyed by the edge map's key (segments are stored as an N x 1 CV_32SC4 Mat)
+static void cached_segments(detector *det, cache_key edge_key)
+{
+    const cached_segment_stage *stage = NULL;
+    int n = sizeof(CACHED_SEGMENT_STAGES) / sizeof(CACHED_SEGMENT_STAGES[0]);
+    for (int i = 0; i < n && edge_key != 0; i++)
+        if (CACHED_SEGMENT_STAGES[i].stage == det->engine->segments)
+            stage = &CACHED_SEGMENT_STAGES[i];
+    if (stage == NULL) {
+        det->engine->segments(det, det->edges, &det->segments);
+        return;
+    }
+    cache_key key = hash_params(stage->name, stage->params, stage->num_params, edge_key);
+    Mat m;
+    if (cache_get(key, m)) {
+        det->segments.clear();
+        if (!m.empty())
+            det->segments.assign(m.ptr<Vec4i>(0), m.ptr<Vec4i>(0) + m.rows);
+        return;
+    }
+    det->engine->segments(det, det->edges, &det->segments);
+    cache_put(key, Mat(det->segments));
+}
+
+// runs the engine's stages in order, timing each one
+//  wall-clock, not clock(): with several streams clock() counts every thread
+void run_detector(detector *det, const Mat &src)
+{
+    det->size = src.size();
+    
+    double t0 = now();
+    cache_key edge_key = cached_edges(det, src);
+    double t1 = now();
+    cached_segments(det, edge_key);
+    double t2 = now();
+    det->engine->model(det, det->segments, &det->lane_lines);
+    build_lane_index(&det->index, det->lane_lines, det->size);
+    if (!det->curves.empty())
+        index_paths(&det->index, det->curves);
+    double t3 = now();
+    
+    det->edge_time = t1-t0;
+    det->segment_time = t2-t1;
+    det->model_time = t3-t2;
+}
+
+// multiplies every coordinate of the detector's output by scale, in place
+//  for frames decoded at reduced size (the edge map is left at reduced size)
+static void scale_lines(vector<Vec4i> *lines, int scale)
+{
+    for (size_t i = 0; i < lines->size(); i++)
+        (*lines)[i] *= scale;
+}
+
+void rescale_result(detector *det, int scale)
+{
+    if (scale == 1)
+        return;
+    scale_lines(&det->segments, scale);
+    scale_lines(&det->combined, scale);
+    scale_lines(&det->lane_lines, scale);
+    scale_curves(&det->curves, scale);
+    det->size = Size(det->size.width * scale, det->size.height * scale);
+    build_lane_index(&det->index, det->lane_lines, det->size);
+    if (!det->curves.empty())
+        index_paths(&det->index, det->curves);
+}
+
+// ------------------------
+
+// fraction of lines that two results have in common
+//  lines match if they are within AGREE_TOLERANCE at the bottom row and halfway up
+//  1.0 = same lines, 0.0 = nothing in common (two empty results agree)
+double agreement(const vector<Vec4i> &ref, const vector<Vec4i> &lines, int height)
+{
+    if (ref.empty() && lines.empty())
+        return 1.0;
+    
+    vector<bool> used(lines.size(), false);
+    int matched = 0;
+    for (size_t i = 0; i < ref.size(); i++) {
+        for (size_t j = 0; j < lines.size(); j++) {
+            if (used[j])
+                continue;
+            if (abs(x_at(ref[i], height) - x_at(lines[j], height)) < AGREE_TOLERANCE &&
+                abs(x_at(ref[i], height/2) - x_at(lines[j], height/2)) < AGREE_TOLERANCE) {
+                used[j] = true;
+                matched++;
+                break;
+            }
+        }
+    }
+    return (double)matched / max(ref.size(), lines.size());
+}
+
+// ===================================================================
+// stages
+// ===================================================================
+
+// source, destinaton, threshold1, threshold2, aperturesize=3, L2gradient=false
+void canny_edges(detector *det, const Mat &src, Mat &edges)
+{
+    TRACE_BEGIN("Canny");
+    Canny(src, edges, CANNY_T1, CANNY_T2, CANNY_APERTURE);
+    TRACE_END("Canny");
+}
+
+// Canny, then only the edges on or next to lane paint (see paint.h), so shadows, cars
+// and guard rails don't reach HoughLinesP
+void paint_edges(detector *det, const Mat &src, Mat &edges)
+{
+    canny_edges(det, src, edges);
+    TRACE_BEGIN("paint_mask");
+    apply_paint_mask(det->colour, src, det->paint, edges);
+    TRACE_END("paint_mask");
+}
+
+// the road rows only: the sky starts at the same row as for remove_skylines()
+void level_line_edges(detector *det, const Mat &src, Mat &edges)
+{
+    TRACE_BEGIN("level_lines");
+    level_lines(src, src.rows / 2, &det->lsd, edges);
+    TRACE_END("level_lines");
+}
+
+// ================ PROBABILISTIC HOUGH LINE TRANSFORM ==================
+//      creates line segments
+// dst: edge-detector output (should be grayscale) 
+// lines: vector to store lines found;
+// rho: resolution of parameter r in pixels (using 1)
+// theta: resolution of parameter theta in radians (using 1 degree)
+// threshold: The minimum number of intersections to “detect” a line
+// minLinLength: The minimum number of points that can form a line. Lines with less than this number of points are disregarded.
+// maxLineGap: The maximum gap between two points to be considered in the same line.
+void hough_segments(detector *det, const Mat &edges, vector<Vec4i> *lines)
+{
+    TRACE_BEGIN("HoughLinesP");
+    HoughLinesP(edges, *lines, 1, CV_PI/180, HLINES_THRESH, HLINES_MINLINE, HLINES_MINGAP);
+    TRACE_END("HoughLinesP");
+    
+    // filter out horizontal lines
+    TRACE_BEGIN("filters");
+    remove_horizontal(lines);
+    remove_skylines(lines, edges.rows);
+    TRACE_END("filters");
+}
+
+// hough_segments with HoughLinesP swapped for anytime_hough: the strongest lines of its
+// first pass come out first, and whatever is left when the budget runs out is dropped
+void anytime_segments(detector *det, const Mat &edges, vector<Vec4i> *lines)
+{
+    TRACE_BEGIN("anytime_hough");
+    det->coverage = anytime_hough(edges, &det->hough, get_hough_budget(),
+                                  HLINES_THRESH, HLINES_MINLINE, HLINES_MINGAP, lines);
+    TRACE_END("anytime_hough");
+    
+    TRACE_BEGIN("filters");
+    remove_horizontal(lines);
+    remove_skylines(lines, edges.rows);
+    TRACE_END("filters");
+}
+
+// segments of the level-line regions, endpoints rounded to the pixel for the filters
+//  and combine_lines (the regions don't split a line the way Hough does, so there are
+//  far fewer pieces to combine)
+void lsd_segments(detector *det, const Mat &edges, vector<Vec4i> *lines)
+{
+    TRACE_BEGIN("grow_segments");
+    vector<Vec4f> &found = det->lsd.segments;
+    grow_segments(edges, &det->lsd, &found);
+    lines->resize(found.size());
+    for (size_t i = 0; i < found.size(); i++)
+        (*lines)[i] = Vec4i(cvRound(found[i][0]), cvRound(found[i][1]), cvRound(found[i][2]), cvRound(found[i][3]));
+    TRACE_END("grow_segments");
+    
+    TRACE_BEGIN("filters");
+    remove_horizontal(lines);
+    remove_skylines(lines, edges.rows);
+    TRACE_END("filters");
+}
+
+void combine_model(detector *det, const vector<Vec4i> &lines, vector<Vec4i> *lane_lines)
+{
+    TRACE_BEGIN("combine_lines");
+    det->combined = combine_lines(lines);
+    TRACE_END("combine_lines");
+    TRACE_BEGIN("extend_lines");
+    *lane_lines = extend_lines(det->combined, det->size.width, det->size.height);
+    TRACE_END("extend_lines");
+}
+
+// combine_model on the segments that point at the vanishing point (all of them if there
+// is no clear one); the estimate is kept in the detector and reused by the next frame
+void vp_model(detector *det, const vector<Vec4i> &lines, vector<Vec4i> *lane_lines)
+{
+    TRACE_BEGIN("vanishing_point");
+    vector<Vec4i> inliers = lines;
+    if (find_vanishing_point(lines, det->size, &det->vp))
+        remove_outliers(&inliers, &det->vp, det->size);
+    TRACE_END("vanishing_point");
+    combine_model(det, inliers, lane_lines);
+}
+
+// fits and updates the curved lanes (curve.h); the lane lines are their chords, bottom
+// to top, and the lane index gets their paths
+void curve_model(detector *det, const vector<Vec4i> &lines, vector<Vec4i> *lane_lines)
+{
+    TRACE_BEGIN("fit_curves");
+    fit_curves(lines, det->size, &det->curves);
+    curve_lines(det->curves, lane_lines);
+    det->combined = *lane_lines;
+    TRACE_END("fit_curves");
+}
+
+// ------------------------
+
+void birdseye_edge_stage(detector *det, const Mat &src, Mat &edges)
+{
+    TRACE_BEGIN("birdseye_edges");
+    birdseye_edges(src, edges, &det->lut);
+    TRACE_END("birdseye_edges");
+}
+
+void birdseye_segment_stage(detector *det, const Mat &edges, vector<Vec4i> *lines)
+{
+    TRACE_BEGIN("birdseye_search");
+    birdseye_search(edges, lines);
+    TRACE_END("birdseye_search");
+}
+
+void birdseye_model_stage(detector *det, const vector<Vec4i> &lines, vector<Vec4i> *lane_lines)
+{
+    TRACE_BEGIN("birdseye_unwarp");
+    *lane_lines = birdseye_unwarp(lines, &det->lut);
+    det->combined = *lane_lines;            // fitted lines are already whole, nothing to extend
+    TRACE_END("birdseye_unwarp");
+}
+
+// ===================================================================
+// output
+// ===================================================================
+
+// the index's lane paths, as polylines in the lane-line colour
+static void draw_paths(Mat &dst, const lane_index *index)
+{
+    int n = (int)(index->paths.size() / index->lines.size());
+    for (size_t i = 0; i < index->lines.size(); i++) {
+        const Point *p = &index->paths[i * n];
+        polylines(dst, &p, &n, 1, false, Scalar(0,255,255), 2, LINE_AA);
+    }
+}
+
+// draws the segments and lane lines a detector found, and the lanes between them,
+// onto the edge map (or onto the source, if the engine's edges aren't in image coordinates)
+Mat draw_result(const Mat &src, detector *det)
+{
+    Mat &dst = det->edges;
+    vector<Vec4i> &lines = det->segments;
+    vector<Vec4i> &lane_lines = det->lane_lines;
+    TRACE_BEGIN("draw");
+    Mat cdst;
+    if (dst.size() == src.size())
+        cvtColor(dst, cdst, COLOR_GRAY2RGB);
+    else
+        cvtColor(src, cdst, COLOR_GRAY2RGB);
+    
+    // -=-=-=-=-=-=-=-=-=-=-=-=- DEBUGGING -=-=-=-=-=-=-=-=-=-=-=-=-
+    //cout << "size of lines: " << lines.size() << endl;
+    //cout << "size of lane_lines: " << lane_lines.size() << endl;
+    //cout << "width: " << dst.cols << "  height: " << dst.rows << endl;
+    //line(cdst, Point(0,0), Point(100,100), Scalar(255,255,255), 2, CV_AA);
+    // -=-=-=-=-=-=-=-=-=-=-=-=- DEBUGGING -=-=-=-=-=-=-=-=-=-=-=-=-
+    
+    // display result:
+    
+    for( size_t i = 0; i < lines.size(); i++ )
+    {
+        Vec4i l = lines[i];
+        //line( cdst, Point(l[X1], l[Y1]), Point(l[X2], l[Y2]), Scalar(255,0,0), 1, CV_AA);
+     
+        // -=-=-=-=-=-=-=-=-=-=-=-=- DEBUGGING -=-=-=-=-=-=-=-=-=-=-=-=-
+        //cout << i << " (" << l[X1] << "," << l[Y1] << ") \t(" << l[X2] << "," << l[Y2] << ")" << endl; 
+        // -=-=-=-=-=-=-=-=-=-=-=-=- DEBUGGING -=-=-=-=-=-=-=-=-=-=-=-=-
+    }
+     
+    //cout << "------" << endl;
+    // display "lane lines"
+    if (!det->index.paths.empty())
+        draw_paths(cdst, &det->index);
+    else for( size_t i = 0; i < lane_lines.size(); i++ )
+    {
+        Vec4i l = lane_lines[i];
+        line( cdst, Point(l[X1], l[Y1]), Point(l[X2], l[Y2]), Scalar(0,255,255), 2, LINE_AA);
+        
+        // -=-=-=-=-=-=-=-=-=-=-=-=- DEBUGGING -=-=-=-=-=-=-=-=-=-=-=-=-
+        //cout << i << " (" << l[X1] << "," << l[Y1] << ") \t(" << l[X2] << "," << l[Y2] << ")" << endl; 
+        // -=-=-=-=-=-=-=-=-=-=-=-=- DEBUGGING -=-=-=-=-=-=-=-=-=-=-=-=-
+    }
+    
+    // one polygon per lane, however many lines were found
+    cdst = draw_lanes(cdst, &det->index);
+    
+    TRACE_END("draw");
+    return cdst;
+}
+
+// draws the lane lines and lanes straight onto the colour frame the detector's input was
+// taken from (same size): no 3-channel copy of the edge map, no blended copy, and the
+// output shows the road instead of its edges
+//  the blend in draw_lanes() never showed (it blends the image with itself), so the
+//  result matches draw_result() apart from the background
+void draw_overlay(Mat &frame, detector *det)
+{
+    TRACE_BEGIN("draw");
+    if (!det->index.paths.empty())
+        draw_paths(frame, &det->index);
+    else for (size_t i = 0; i < det->lane_lines.size(); i++) {
+        Vec4i l = det->lane_lines[i];
+        line(frame, Point(l[X1], l[Y1]), Point(l[X2], l[Y2]), Scalar(0,255,255), 2, LINE_AA);
+    }
+    fill_lanes(frame, &det->index);
+    TRACE_END("draw");
+}
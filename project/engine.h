@@ -0,0 +1,102 @@
+//
+//  engine.h
+//  opencv
+//
+//  pluggable lane-detection engines:
+//  an engine is three replaceable stages (edges -> segments -> lane model),
+//  listed by name in a registry and chosen at runtime with -e
+
+#ifndef opencv_engine_h
+#define opencv_engine_h
+
+#include "project.h"
+#include "birdseye.h"
+#include "trace.h"
+#include "cache.h"
+#include "paint.h"
+#include "vanish.h"
+#include "curve.h"
+#include "anytime.h"
+#include "lsd.h"
+
+// name of the engine all others are compared against by the benchmark harness
+#define REFERENCE_ENGINE    "hough"
+
+// how close (in px) two lines must be, at the bottom and the top of the road, to "agree"
+const double AGREE_TOLERANCE = 25;
+
+struct detector;
+
+// stage signatures:
+//  edges:    grayscale frame -> edge map (any coordinate system the engine likes)
+//  segments: edge map -> line segments
+//  model:    segments -> final lane lines, in image coordinates
+typedef void (*edge_stage)(detector *, const Mat &, Mat &);
+typedef void (*segment_stage)(detector *, const Mat &, vector<Vec4i> *);
+typedef void (*model_stage)(detector *, const vector<Vec4i> &, vector<Vec4i> *);
+
+struct lane_engine {
+    const char *name;
+    edge_stage edges;
+    segment_stage segments;
+    model_stage model;
+    bool cacheable;                         // edge/segment stages keep no state in the detector, so
+                                            //  their outputs can come from the stage cache (cache.h)
+    bool colour;                            // edge stage reads the colour frame (det->colour), so
+                                            //  callers should decode in colour
+};
+
+// per-stream detector: chosen engine, state kept between frames, and last frame's output
+struct detector {
+    const lane_engine *engine;
+    Size size;                              // size of the last frame
+    Mat colour;                             // colour frame the grayscale one was taken from, if the
+                                            //  caller decoded one (set before run_detector, else empty)
+    Mat edges;                              // edge stage output
+    vector<Vec4i> segments;                 // segment stage output
+    vector<Vec4i> combined;                 // model stage: lines before extending (combine_lines output)
+    vector<Vec4i> lane_lines;               // model stage output
+    lane_index index;                       // lane_lines ordered left to right (built after the model stage)
+    double edge_time, segment_time, model_time;     // stage times of the last frame (s)
+    birdseye_lut lut;                       // birdseye engine: remap table
+    Mat paint;                              // paint engine: lane-paint mask (reused between frames)
+    vanishing_point vp;                     // vp engine: last frame's vanishing point
+    vector<lane_curve> curves;              // curve engine: fitted lanes, carried over between frames
+    hough_buffers hough;                    // anytime engine: accumulator etc. (reused between frames)
+    double coverage;                        // anytime engine: share of the edge points looked at last
+                                            //  frame (anytime_hough), -1 for other engines
+    lsd_buffers lsd;                        // lsd engine: scratch space (reused between frames)
+};
+
+// registry
+int num_engines();
+const lane_engine *get_engine(int);
+const lane_engine *find_engine(const char *);   // NULL if no engine has that name
+
+void init_detector(detector *, const lane_engine *);
+void run_detector(detector *, const Mat &);     // runs all three stages on a grayscale frame (cached, if enabled)
+
+Mat draw_result(const Mat &, detector *);      // overlay of the lines/lanes found on a frame
+void draw_overlay(Mat &, detector *);           // the same, drawn in place on the colour frame
+void rescale_result(detector *, int);           // lines/size of a reduced frame back to full size
+
+// comparing results
+double agreement(const vector<Vec4i> &, const vector<Vec4i> &, int);   // fraction of lines that match
+
+// ---
+// stages available to engines
+// ---
+void canny_edges(detector *, const Mat &, Mat &);                       // Canny on the full frame
+void paint_edges(detector *, const Mat &, Mat &);                       // Canny, AND the lane-paint mask
+void level_line_edges(detector *, const Mat &, Mat &);                  // level-line angles of the road rows (lsd.h)
+void hough_segments(detector *, const Mat &, vector<Vec4i> *);          // HoughLinesP + remove_horizontal/skylines
+void anytime_segments(detector *, const Mat &, vector<Vec4i> *);        // the same, within the -H budget
+void lsd_segments(detector *, const Mat &, vector<Vec4i> *);            // regions of level_line_edges + remove_horizontal/skylines
+void combine_model(detector *, const vector<Vec4i> &, vector<Vec4i> *); // combine_lines + extend_lines
+void vp_model(detector *, const vector<Vec4i> &, vector<Vec4i> *);      // drop segments missing the vanishing point, then combine_model
+void curve_model(detector *, const vector<Vec4i> &, vector<Vec4i> *);   // quadratic lanes, updated frame to frame
+void birdseye_edge_stage(detector *, const Mat &, Mat &);               // remap to top-down + Canny
+void birdseye_segment_stage(detector *, const Mat &, vector<Vec4i> *);  // histogram + sliding windows
+void birdseye_model_stage(detector *, const vector<Vec4i> &, vector<Vec4i> *);  // back to image coordinates
+
+#endif
@@ -0,0 +1,197 @@
+//
+//  lsd.cpp
+//  opencv
+//
+
+#include "lsd.h"
+
+// unit vector of each angle code (the middle of its 360/255 degree bin)
+struct angle_table {
+    double cos[256], sin[256];
+};
+
+static angle_table make_angle_table()
+{
+    angle_table t;
+    t.cos[0] = t.sin[0] = 0;
+    for (int c = 1; c < 256; c++) {
+        double a = (c - 0.5) * 2 * CV_PI / 255;
+        t.cos[c] = cos(a);
+        t.sin[c] = sin(a);
+    }
+    return t;
+}
+
+static const angle_table &angles()
+{
+    static const angle_table table = make_angle_table();   // built once, thread-safe
+    return table;
+}
+
+// the gradient of a pixel is taken over its 2x2 block (LSD's choice: the smallest
+// support, so neighbouring lines don't blur into each other)
+void level_lines(const Mat &gray, int top, lsd_buffers *buf, Mat &codes)
+{
+    Mat &smooth = buf->smooth;
+    codes.create(gray.size(), CV_8UC1);
+    codes.setTo(Scalar(0));
+    GaussianBlur(gray.rowRange(top, gray.rows), smooth, Size(5, 5), LSD_SIGMA);
+    
+    int min2 = cvRound(4 * LSD_GRADIENT * LSD_GRADIENT);   // gx, gy below are 2x the gradient
+    for (int y = 0; y + 1 < smooth.rows; y++) {
+        const uchar *r0 = smooth.ptr<uchar>(y), *r1 = smooth.ptr<uchar>(y + 1);
+        uchar *out = codes.ptr<uchar>(top + y);
+        for (int x = 0; x + 1 < smooth.cols; x++) {
+            int gx = r0[x+1] + r1[x+1] - r0[x] - r1[x];
+            int gy = r1[x] + r1[x+1] - r0[x] - r0[x+1];
+            if (gx*gx + gy*gy < min2)
+                continue;
+            float deg = fastAtan2((float)gx, (float)-gy);      // level line: gradient turned 90 degrees
+            out[x] = (uchar)(1 + min((int)(deg * 255 / 360), 254));
+        }
+    }
+}
+
+// ------------------------
+
+// bounding rectangle of a region, along its principal axis
+struct region_rect {
+    Point2d centre, axis;
+    double t0, t1;                          // extent along the axis, from the centre
+    double length, width;
+    double density;                         // pixels / (length x width)
+};
+
+// 8-connected free pixels within tol_cos of the region's mean angle, grown from seed
+//  (the mean is updated as pixels join); the region's pixels are taken out of free
+static void grow_region(Mat &free, Point seed, double tol_cos, vector<Point> *region)
+{
+    const angle_table &t = angles();
+    uchar *s = free.ptr<uchar>(seed.y) + seed.x;
+    double sum_cos = t.cos[*s], sum_sin = t.sin[*s];
+    *s = 0;
+    region->clear();
+    region->push_back(seed);
+    for (size_t i = 0; i < region->size(); i++) {
+        Point p = (*region)[i];
+        double n = sqrt(sum_cos*sum_cos + sum_sin*sum_sin);
+        double rc = sum_cos / n, rs = sum_sin / n;
+        for (int y = max(p.y - 1, 0); y <= min(p.y + 1, free.rows - 1); y++) {
+            uchar *row = free.ptr<uchar>(y);
+            for (int x = max(p.x - 1, 0); x <= min(p.x + 1, free.cols - 1); x++) {
+                uchar c = row[x];
+                if (c == 0 || t.cos[c]*rc + t.sin[c]*rs < tol_cos)
+                    continue;
+                row[x] = 0;
+                region->push_back(Point(x, y));
+                sum_cos += t.cos[c];
+                sum_sin += t.sin[c];
+            }
+        }
+    }
+}
+
+static void release_region(const Mat &codes, Mat &free, const vector<Point> &region)
+{
+    for (size_t i = 0; i < region.size(); i++)
+        free.at<uchar>(region[i]) = codes.at<uchar>(region[i]);
+}
+
+static void fit_rect(const vector<Point> &region, region_rect *r)
+{
+    double n = (double)region.size(), sx = 0, sy = 0;
+    for (size_t i = 0; i < region.size(); i++) {
+        sx += region[i].x;
+        sy += region[i].y;
+    }
+    r->centre = Point2d(sx / n, sy / n);
+    double cxx = 0, cxy = 0, cyy = 0;
+    for (size_t i = 0; i < region.size(); i++) {
+        double dx = region[i].x - r->centre.x, dy = region[i].y - r->centre.y;
+        cxx += dx*dx;
+        cxy += dx*dy;
+        cyy += dy*dy;
+    }
+    double theta = 0.5 * atan2(2 * cxy, cxx - cyy);
+    r->axis = Point2d(cos(theta), sin(theta));
+    
+    double u0 = 0, u1 = 0;
+    r->t0 = r->t1 = 0;
+    for (size_t i = 0; i < region.size(); i++) {
+        double dx = region[i].x - r->centre.x, dy = region[i].y - r->centre.y;
+        double t = dx * r->axis.x + dy * r->axis.y, u = dy * r->axis.x - dx * r->axis.y;
+        r->t0 = min(r->t0, t);
+        r->t1 = max(r->t1, t);
+        u0 = min(u0, u);
+        u1 = max(u1, u);
+    }
+    r->length = r->t1 - r->t0 + 1;
+    r->width = u1 - u0 + 1;
+    r->density = n / (r->length * r->width);
+}
+
+// LSD's fix for a region too sparse for its rectangle (two lines meeting at a shallow
+// angle, or a line plus texture that happens to line up): regrown from the seed with half
+// the tolerance, then cut back to a shrinking radius around the seed until it is dense
+// enough; false if too few pixels are left
+static bool refine_region(const Mat &codes, lsd_buffers *buf, Point seed, region_rect *r)
+{
+    vector<Point> &region = buf->region;
+    release_region(codes, buf->free, region);
+    grow_region(buf->free, seed, cos(LSD_TOLERANCE / 2 * CV_PI / 180), &region);
+    if ((int)region.size() < LSD_MIN_PIXELS)
+        return false;
+    fit_rect(region, r);
+    
+    double radius2 = 0;
+    for (size_t i = 0; i < region.size(); i++) {
+        Point d = region[i] - seed;
+        radius2 = max(radius2, (double)d.dot(d));
+    }
+    while (r->density < LSD_DENSITY) {
+        radius2 *= LSD_SHRINK * LSD_SHRINK;
+        size_t kept = 0;
+        for (size_t i = 0; i < region.size(); i++) {
+            Point d = region[i] - seed;
+            if (d.dot(d) <= radius2)
+                region[kept++] = region[i];
+            else
+                buf->free.at<uchar>(region[i]) = codes.at<uchar>(region[i]);
+        }
+        region.resize(kept);
+        if ((int)region.size() < LSD_MIN_PIXELS)
+            return false;
+        fit_rect(region, r);
+    }
+    return true;
+}
+
+// seeds are taken bottom up, the nearest road first (LSD takes the strongest gradients
+// first, which would need the magnitudes kept as well); a region's pixels can't seed or
+// join another region, even if the region is rejected
+void grow_segments(const Mat &codes, lsd_buffers *buf, vector<Vec4f> *segments)
+{
+    segments->clear();
+    codes.copyTo(buf->free);
+    double tol_cos = cos(LSD_TOLERANCE * CV_PI / 180);
+    region_rect r;
+    for (int y = codes.rows - 1; y >= 0; y--) {
+        const uchar *row = buf->free.ptr<uchar>(y);
+        for (int x = 0; x < codes.cols; x++) {
+            if (row[x] == 0)
+                continue;
+            grow_region(buf->free, Point(x, y), tol_cos, &buf->region);
+            if ((int)buf->region.size() < LSD_MIN_PIXELS)
+                continue;
+            fit_rect(buf->region, &r);
+            if (r.density < LSD_DENSITY && !refine_region(codes, buf, Point(x, y), &r))
+                continue;
+            if (r.length < LSD_MIN_LENGTH)
+                continue;
+            // + 0.5: a pixel's gradient is at the centre of its 2x2 block
+            Point2d a = r.centre + r.axis * r.t0 + Point2d(0.5, 0.5);
+            Point2d b = r.centre + r.axis * r.t1 + Point2d(0.5, 0.5);
+            segments->push_back(Vec4f((float)a.x, (float)a.y, (float)b.x, (float)b.y));
+        }
+    }
+}
@@ -0,0 +1,41 @@
+//
+//  lsd.h
+//  opencv
+//
+//  line segment detector after LSD (von Gioi et al.): pixels whose gradient is strong
+//  enough are grouped into regions of (nearly) the same level-line angle, and each region
+//  whose pixels fill enough of its bounding rectangle is a segment along the rectangle's
+//  axis, with sub-pixel endpoints
+//
+//  no edge map to vote from and no accumulator: one pass over the road rows for the
+//  gradient, one for the regions, and whole lines come out rather than Hough fragments
+//  (LSD's a-contrario validation is replaced by the density and length checks)
+
+#ifndef opencv_lsd_h
+#define opencv_lsd_h
+
+#include "project.h"
+
+const double LSD_SIGMA = 0.8;               // Gaussian smoothing before the gradient (LSD's value)
+const double LSD_GRADIENT = 20;             // min gradient magnitude (2x2 differences, grey levels)
+const double LSD_TOLERANCE = 22.5;          // max angle (degrees) between a pixel and its region
+const double LSD_DENSITY = 0.5;             // min share of its rectangle a region must fill
+const int LSD_MIN_PIXELS = 10;              // smaller regions are noise
+const double LSD_MIN_LENGTH = HLINES_MINLINE / 2;   // shorter segments are dropped
+const double LSD_SHRINK = 0.75;             // radius factor per step when a region is cut back
+
+// scratch space, kept between frames
+struct lsd_buffers {
+    Mat smooth;                             // level_lines: the smoothed road rows
+    Mat free;                               // grow_segments: angle codes of the pixels not in a region yet
+    vector<Point> region;
+    vector<Vec4f> segments;                 // grow_segments output, before rounding
+};
+
+// the level-line angle of every pixel from row top down whose gradient is at least
+//  LSD_GRADIENT, as 1..255 (0 elsewhere, and above top)
+void level_lines(const Mat &, int, lsd_buffers *, Mat &);
+// segments of the regions in a level_lines() map (one pixel = its 2x2 block's centre)
+void grow_segments(const Mat &, lsd_buffers *, vector<Vec4f> *);
+
+#endif
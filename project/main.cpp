@@ -5,113 +5,176 @@
 //  lane-detection of an image
 
 #include "project.h"
+#include "engine.h"
+#include "bench.h"
+#include "source.h"
+#include "change.h"
+#include "streams.h"
+#include "pool.h"
+#include "rt.h"
+#include "daemon.h"
+#include "results.h"
+#include "band.h"
+#include "synth.h"
+#include "cache.h"
+#include "departure.h"
+#include "telemetry.h"
+#include <unistd.h>
+#include <cerrno>
+#include <signal.h>
 
-int main (int argc, const char * argv[])
+// prints command-line usage, with the names of all registered engines
+void usage(const char *prog)
 {
-    clock_t start = clock();
-    
-    const char* filename = argc >= 2 ? argv[1] : "images/road3.png";
+    cout << "usage: " << prog << " [-e engine] [-b] [-u] [-v video|cam:N] [-s source[@weight] ...] [-j workers] [-N] [-p|-P] [-c cpus] [-r fifo:N|rr:N] [-m] [-J] [-d socket] [-R file] [-F ndjson|bin] [-n] [-S 2|4|8] [-T] [-C] [-B rows] [-W size] [-G scene] [-X] [-k|-K dir] [-g] [-M] [-L] [-H ms[,points]] [-E socket] [-w file.lrec] [-y] [-a files] [-i] [-t trace.json] [image ...]" << endl;
+    cout << "  -e: detection engine (default " << REFERENCE_ENGINE << "), one of:";
+    for (int i = 0; i < num_engines(); i++)
+        cout << " " << get_engine(i)->name;
+    cout << endl;
+    cout << "  -b: benchmark every engine on the images against " << REFERENCE_ENGINE
+         << ", no output image" << endl;
+    cout << "  -v: process a video file, camera or recording (.lrec, see -w) instead of images" << endl;
+    cout << "  -u: reuse the last result for frames that haven't changed (video, several images)" << endl;
+    cout << "  -s: add a stream (video, cam:N or image), repeat for several cameras processed together;" << endl;
+    cout << "      @weight gives a stream a bigger share of the workers (e.g. -s cam:0@3 for the front camera)" << endl;
+    cout << "  -j: number of worker threads shared by the streams (default: number of cpus)" << endl;
+    cout << "  -N: with -s, run the streams again one process each (1/N of the workers apiece) and" << endl;
+    cout << "      compare the throughput with the shared pool (files only: a camera never ends)" << endl;
+    cout << "  -p: allocate images from a pool (-P: with huge pages), report allocations per frame" << endl;
+    cout << "  -c: pin threads to these cpus, one per thread in turn (e.g. 2,3 or 1-3)" << endl;
+    cout << "  -r: real-time scheduling for the processing threads: fifo:PRIO or rr:PRIO" << endl;
+    cout << "  -m: lock all memory (mlockall)" << endl;
+    cout << "  -J: frame latency percentiles of the first image, default vs -c/-r/-m settings" << endl;
+    cout << "  -d: stay resident and serve detection requests on a unix socket (see lane_client)" << endl;
+    cout << "  -R: write each frame's segments and lane lines to a file (- = stdout)" << endl;
+    cout << "  -F: format of -R: ndjson (default) or bin (fixed-layout binary records)" << endl;
+    cout << "  -n: no output image (use with -R)" << endl;
+    cout << "  -S: decode images at 1/2, 1/4 or 1/8 size (lines are reported at full size;" << endl;
+    cout << "      a recording keeps the scale it was made at)" << endl;
+    cout << "  -T: don't decode the sky rows of JPEG images (needs a -DHAVE_LIBJPEG build)" << endl;
+    cout << "  -C: decode in colour and draw the lanes on the colour image (default: on the edge map;" << endl;
+    cout << "      implied by engines that read the colour frame, e.g. paint)" << endl;
+    cout << "  -B: process the image in bands of this many rows, for images too big for memory" << endl;
+    cout << "      (streamed from PGM, or JPEG in a -DHAVE_LIBJPEG build; no output image)" << endl;
+    cout << "  -W: check -B peak memory on a synthetic size x size image (e.g. -W 20000)" << endl;
+    cout << "  -G: write synthetic road frames + ground truth to images/synth_NNNN.{png,txt}; scene is" << endl;
+    cout << "      WxH[,lanes=N][,curve=F][,dashed=0|1][,shadows=N][,noise=F][,clutter=N][,seed=N][,count=N]" << endl;
+    cout << "  -X: benchmark every engine on synthetic frames from 640x480 to 7680x4320 (scene options from -G)" << endl;
+    cout << "  -k: cache decoded images, edge maps and segments in memory, keyed by content + parameters" << endl;
+    cout << "  -K: the same, also kept on disk in dir, for parameter sweeps over several builds/runs" << endl;
+    cout << "  -g: time pairwise line tests on the images' segments, Vec4i/double vs int16/fixed-point" << endl;
+    cout << "  -M: edge pixels, segments and stage times of the images with the lane-paint mask off and on" << endl;
+    cout << "  -L: fragments, combined lines and stage times of the images, Canny + HoughLinesP vs lsd" << endl;
+    cout << "  -H: budget of the anytime engine's segment stage per frame: ms, and/or edge points voted" << endl;
+    cout << "      (default " << ANYTIME_BUDGET_MS << " ms; e.g. -H 0,20000 for a fixed amount of work)" << endl;
+    cout << "  -E: send lane-departure events to a local datagram socket (e.g. " << DEFAULT_EVENT_SOCKET << "," << endl;
+    cout << "      see lane_client -E) right after detection, and report capture-to-event latency" << endl;
+    cout << "  -w: record the frames of -v or of the images (gray, or BGR with -C) and their capture" << endl;
+    cout << "      times to a file, for repeatable runs with -v file.lrec (no detection)" << endl;
+    cout << "  -y: replay recordings at their recorded rate (default: as fast as possible)" << endl;
+    cout << "  -a: read this many image files ahead (e.g. " << PREFETCH_DEPTH << ") and decode them from memory, reporting" << endl;
+    cout << "      the time spent waiting for reads apart from decoding (io_uring in a -DHAVE_LIBURING build)" << endl;
+    cout << "  -i: sample cpu clock, temperature, throttling and RAPL energy after each frame: summary, and" << endl;
+    cout << "      stage times + readings in each -R ndjson record (for frames per joule, thermal effects)" << endl;
+    cout << "  -t: record a per-frame timeline of every stage, written as Chrome trace JSON to the file" << endl;
+}
+
+// what a single image or sequence run produces
+struct run_options {
+    const lane_engine *engine;
+    bool skip_unchanged;                    // -u
+    bool write_image;                       // overlay image(s) drawn and written (off with -n)
+    result_writer *results;                 // per-frame result stream (-R), NULL if none
+    int scale;                              // decode at 1/scale size (-S), results rescaled to full size
+    bool roi_only;                          // don't decode the sky rows (-T)
+    bool colour;                            // decode in colour, overlay on the colour frame (-C)
+    departure_state *events;                // lane-departure events (-E), NULL if none
+    telemetry *machine;                     // machine state sampled per frame (-i), NULL if none
+};
+
+// samples the machine's state once a frame is done, for its record (NULL without -i)
+static const telemetry_sample *frame_telemetry(const run_options *opts, telemetry_sample *sample)
+{
+    if (opts->machine == NULL)
+        return NULL;
+    sample_telemetry(opts->machine, sample);
+    return sample;
+}
 
-    cout << "running opencv with " << filename << endl;
+// capture-to-event latency of the frames so far (the last DEPART_LATENCY_FRAMES), and
+// capture to output image (if any)
+static void print_events(departure_state *events, double image_latency, int images)
+{
+    vector<double> latency = events->latency;  // a copy: percentile() sorts, the ring stays in order
+    if (latency.empty())
+        return;
+    double sum = 0;
+    for (size_t i = 0; i < latency.size(); i++)
+        sum += latency[i];
+    double p99 = percentile(latency, 0.99);    // sorts: the last one is the worst
+    cout << "events:     " << events->events << " sent, " << events->dropped << " not delivered" << endl;
+    cout << "capture to event: " << 1000 * sum / latency.size() << " ms avg, "
+         << 1000 * p99 << " ms p99, " << 1000 * latency.back() << " ms max";
+    if (events->frames > (long)latency.size())
+        cout << " (last " << latency.size() << " of " << events->frames << " frames)";
+    cout << endl;
+    if (images > 0)
+        cout << "capture to image: " << 1000 * image_latency / images << " ms avg" << endl;
+}
+
+// runs one engine on a single image, writes images/output.png and prints stage times
+int run_image(const char *filename, const run_options *opts, clock_t start)
+{
+    const lane_engine *engine = opts->engine;
+    cout << "running opencv with " << filename << " (" << engine->name << ")" << endl;
     
     // create image matrix
     // loading image in non-grayscale causes an error
-    Mat src = imread(filename, IMREAD_GRAYSCALE);
+    //  (-C: decoded in colour once, and the grayscale frame derived from it)
+    clock_t decode_start = clock();
+    double captured = now();
+    TRACE_BEGIN("decode");
+    Mat frame = decode_image(filename, opts->scale, opts->roi_only, opts->colour);
+    Mat src = frame;
+    if (opts->colour && !frame.empty())
+        to_luma(frame, src);
+    TRACE_END("decode");
+    double decode_time = (double)(clock()-decode_start)/CLOCKS_PER_SEC;
     if (src.empty()) {
         //help();
         cout << "cannot open " << filename << endl;
         return -1;
     }
     
-    // beginning time:
-    clock_t canny_start = clock();
-    
-    // create destination matrix
-    Mat dst, cdst;
-    // use Canny for edge-detection
-    // source, destinaton, threshold1, threshold2, aperturesize=3, L2gradient=false
-    blur(dst, dst, Size(3,3));
-    Canny(src, dst, CANNY_T1, CANNY_T2, CANNY_APERTURE);
-    cvtColor(dst, cdst, COLOR_GRAY2RGB);
+    // run the edge, segment and lane-model stages of the engine
+    detector det;
+    init_detector(&det, engine);
+    if (opts->colour)
+        det.colour = frame;
+    run_detector(&det, src);
+    if (opts->events != NULL)
+        update_departure(opts->events, &det.index, det.size, 0, captured);
+    double canny_time = det.edge_time;
+    double hough_time = det.segment_time;
+    double lines_time = det.model_time;
     
-    // time of canny
-    clock_t canny_end = clock();
-    double canny_time = (double)(canny_end-canny_start)/CLOCKS_PER_SEC;
-    
-    // ================ PROBABILISTIC HOUGH LINE TRANSFORM ==================
-    //      creates line segments
-    // dst: edge-detector output (should be grayscale) 
-    // lines: vector to store lines found;
-    // rho: resolution of parameter r in pixels (using 1)
-    // theta: resolution of parameter theta in radians (using 1 degree)
-    // threshold: The minimum number of intersections to “detect” a line
-    // minLinLength: The minimum number of points that can form a line. Lines with less than this number of points are disregarded.
-    // maxLineGap: The maximum gap between two points to be considered in the same line.
-    
-    clock_t hough_start = clock();
-    
-    vector<Vec4i> lines;
-    HoughLinesP(dst, lines, 1, CV_PI/180, HLINES_THRESH, HLINES_MINLINE, HLINES_MINGAP);
-    
-    // filter out horizontal lines
-    remove_horizontal(&lines);
-    remove_skylines(&lines, dst.rows);
-    
-    // time of HoughLinesP()
-    clock_t hough_end = clock();
-    double hough_time = (double)(hough_end-hough_start)/CLOCKS_PER_SEC;
-    
-    // --------------------------
-    
-    clock_t lines_start = clock();
-    
-    vector<Vec4i> lane_lines = combine_lines(lines);
-    lane_lines = extend_lines(lane_lines, dst.cols, dst.rows);
-    
-    // time of lane_lines, extend_lines()
-    clock_t lines_end = clock();
-    double lines_time = (double)(lines_end-lines_start)/CLOCKS_PER_SEC;
-    
-    // -=-=-=-=-=-=-=-=-=-=-=-=- DEBUGGING -=-=-=-=-=-=-=-=-=-=-=-=-
-    //cout << "size of lines: " << lines.size() << endl;
-    //cout << "size of lane_lines: " << lane_lines.size() << endl;
-    //cout << "width: " << dst.cols << "  height: " << dst.rows << endl;
-    //line(cdst, Point(0,0), Point(100,100), Scalar(255,255,255), 2, CV_AA);
-    // -=-=-=-=-=-=-=-=-=-=-=-=- DEBUGGING -=-=-=-=-=-=-=-=-=-=-=-=-
-
     clock_t draw_start = clock();
     
-    // display result:
-    
-    for( size_t i = 0; i < lines.size(); i++ )
-    {
-        Vec4i l = lines[i];
-        //line( cdst, Point(l[X1], l[Y1]), Point(l[X2], l[Y2]), Scalar(255,0,0), 1, CV_AA);
-     
-        // -=-=-=-=-=-=-=-=-=-=-=-=- DEBUGGING -=-=-=-=-=-=-=-=-=-=-=-=-
-        //cout << i << " (" << l[X1] << "," << l[Y1] << ") \t(" << l[X2] << "," << l[Y2] << ")" << endl; 
-        // -=-=-=-=-=-=-=-=-=-=-=-=- DEBUGGING -=-=-=-=-=-=-=-=-=-=-=-=-
-    }
-     
-    //cout << "------" << endl;
-    // display "lane lines"
-    for( size_t i = 0; i < lane_lines.size(); i++ )
-    {
-        Vec4i l = lane_lines[i];
-        line( cdst, Point(l[X1], l[Y1]), Point(l[X2], l[Y2]), Scalar(0,255,255), 2, LINE_AA);
-        
-        // -=-=-=-=-=-=-=-=-=-=-=-=- DEBUGGING -=-=-=-=-=-=-=-=-=-=-=-=-
-        //cout << i << " (" << l[X1] << "," << l[Y1] << ") \t(" << l[X2] << "," << l[Y2] << ")" << endl; 
-        // -=-=-=-=-=-=-=-=-=-=-=-=- DEBUGGING -=-=-=-=-=-=-=-=-=-=-=-=-
+    // overlay is drawn at decoded size; results are reported at full size
+    Mat cdst;
+    if (opts->write_image && opts->colour) {
+        draw_overlay(frame, &det);
+        cdst = frame;
     }
+    else if (opts->write_image)
+        cdst = draw_result(src, &det);
+    rescale_result(&det, opts->scale);
+    telemetry_sample sample;
+    const telemetry_sample *reading = frame_telemetry(opts, &sample);
+    if (opts->results != NULL)
+        write_result(opts->results, 0, &det, reading);
     cout << endl;
     
-    // depending on # of lines, draw either one or two lanes
-    if (lane_lines.size() > 2)
-        cdst = draw_2lanes(cdst, lane_lines);
-    else
-        cdst = draw_1lane(cdst, lane_lines);
-    
     // time for drawing lines
     clock_t draw_end = clock();
     double draw_time = (double)(draw_end-draw_start)/CLOCKS_PER_SEC;
@@ -122,10 +185,15 @@ int main (int argc, const char * argv[])
     clock_t image_start = clock();
     
     // create output image: .png file
-    vector<int> compression_params;
-    compression_params.push_back(IMWRITE_PNG_COMPRESSION);
-    compression_params.push_back(9);    // 0-9 for png quality
-    imwrite("images/output.png", cdst, compression_params);
+    if (opts->write_image) {
+        vector<int> compression_params;
+        compression_params.push_back(IMWRITE_PNG_COMPRESSION);
+        compression_params.push_back(9);    // 0-9 for png quality
+        TRACE_BEGIN("encode");
+        imwrite("images/output.png", cdst, compression_params);
+        TRACE_END("encode");
+    }
+    double image_latency = now() - captured;
     
     // time for generating the image and total time
     clock_t end = clock();
@@ -134,17 +202,586 @@ int main (int argc, const char * argv[])
     
     // --------------------------
     // display time results:
+    cout << "decode time: " << decode_time << " s" << endl;
     cout << "canny time: " << canny_time << " s" << endl;
     cout << "hough time: " << hough_time << " s" << endl;
     cout << "lines time: " << lines_time << " s" << endl;
+    if (det.coverage >= 0)
+        cout << "coverage:   " << 100 * det.coverage << "% of edge points" << endl;
     cout << "draw time:  " << draw_time << " s" << endl;
     cout << "img time:   " << image_time << " s" << endl;
     cout << "TOTAL TIME: " << total_time << " s" << endl;
+    if (opts->events != NULL)
+        print_events(opts->events, image_latency, opts->write_image ? 1 : 0);
+    if (opts->machine != NULL)
+        print_telemetry(opts->machine, 1);
     
-    cout << "\ndone" << endl;
+    return 0;
+}
+
+// runs one engine over every frame of a source, writing images/output_NNNN.png per frame
+//  skip_unchanged: frames that barely differ from the last processed one reuse its
+//  lane lines and its encoded output image (no detection, drawing or encoding)
+int run_sequence(frame_source *source, const run_options *opts)
+{
+    const lane_engine *engine = opts->engine;
+    bool skip_unchanged = opts->skip_unchanged;
+    cout << "running opencv with " << source->name << " (" << engine->name << ")" << endl;
     
+    detector det;
+    init_detector(&det, engine);
+    change_detector cd;
+    init_change_detector(&cd);
     
+    vector<int> compression_params;
+    compression_params.push_back(IMWRITE_PNG_COMPRESSION);
+    compression_params.push_back(9);    // 0-9 for png quality
+    vector<uchar> png;                  // last encoded output image
+    
+    Mat src;
+    double detect_time = 0, draw_time = 0, image_time = 0;
+    double coverage = 0, min_coverage = 1;
+    int detected = 0;
+    double image_latency = 0;
+    int images = 0;
+    int frames = 0;
+    clock_t start = clock();
+    alloc_counters before, after_first, after;
+    get_alloc_counters(&before);
+    after_first = before;
+    
+    trace_frame(frames);
+    while (next_frame(source, src)) {
+        if (!skip_unchanged || frame_changed(&cd, src)) {
+            clock_t t0 = clock();
+            if (opts->colour)
+                det.colour = source->frame;
+            run_detector(&det, src);
+            if (opts->events != NULL)
+                update_departure(opts->events, &det.index, det.size, frames, source->captured);
+            clock_t t1 = clock();
+            if (det.coverage >= 0) {
+                coverage += det.coverage;
+                min_coverage = min(min_coverage, det.coverage);
+                detected++;
+            }
+            Mat cdst;
+            if (opts->write_image && opts->colour) {
+                draw_overlay(source->frame, &det);
+                cdst = source->frame;
+            }
+            else if (opts->write_image)
+                cdst = draw_result(src, &det);
+            rescale_result(&det, opts->scale);
+            clock_t t2 = clock();
+            if (opts->write_image) {
+                TRACE_BEGIN("encode");
+                imencode(".png", cdst, png, compression_params);
+                TRACE_END("encode");
+                image_latency += now() - source->captured;
+                images++;
+            }
+            clock_t t3 = clock();
+            detect_time += (double)(t1-t0)/CLOCKS_PER_SEC;
+            draw_time += (double)(t2-t1)/CLOCKS_PER_SEC;
+            image_time += (double)(t3-t2)/CLOCKS_PER_SEC;
+        }
+        
+        // unchanged frames repeat the last result and image (and stage times)
+        telemetry_sample sample;
+        const telemetry_sample *reading = frame_telemetry(opts, &sample);
+        if (opts->results != NULL)
+            write_result(opts->results, frames, &det, reading);
+        if (opts->write_image) {
+            char name[64];
+            sprintf(name, "images/output_%04d.png", frames);
+            FILE *out = fopen(name, "wb");
+            if (out) {
+                fwrite(&png[0], 1, png.size(), out);
+                fclose(out);
+            }
+        }
+        trace_frame(++frames);
+        if (frames == 1)
+            get_alloc_counters(&after_first);
+    }
+    double total_time = (double)(clock()-start)/CLOCKS_PER_SEC;
+    get_alloc_counters(&after);
+    
+    if (frames == 0) {
+        cout << "no frames read from " << source->name << endl;
+        return -1;
+    }
+    // --------------------------
+    // display time results (per frame):
+    cout << "frames:     " << frames << endl;
+    cout << "decode time: " << source->decode_time / frames << " s" << endl;
+    if (source->prefetch != NULL)
+        cout << "io wait:    " << source->io_wait / frames << " s (" << source->prefetch->bytes / frames / 1024
+             << " KB read ahead per frame, " << (source->prefetch->uring ? "io_uring" : "threads") << ")" << endl;
+    cout << "detect time: " << detect_time / frames << " s" << endl;
+    cout << "draw time:  " << draw_time / frames << " s" << endl;
+    cout << "img time:   " << image_time / frames << " s" << endl;
+    cout << "TOTAL TIME: " << total_time / frames << " s" << endl;
+    if (skip_unchanged)
+        cout << "skipped:    " << cd.skipped << " of " << cd.frames << " frames ("
+             << 100.0 * cd.skipped / cd.frames << "%)" << endl;
+    if (detected > 0)
+        cout << "coverage:   " << 100 * coverage / detected << "% of edge points (min "
+             << 100 * min_coverage << "%)" << endl;
+    if (opts->events != NULL)
+        print_events(opts->events, image_latency, images);
+    if (opts->machine != NULL)
+        print_telemetry(opts->machine, frames);
+    
+    // first frame fills the pool; afterwards it should need no new buffers
+    if (mat_pool_enabled()) {
+        alloc_counters first, steady;
+        alloc_delta(&before, &after_first, &first);
+        alloc_delta(&after_first, &after, &steady);
+        print_allocs("first frame: ", &first, 1);
+        print_allocs("later frames: ", &steady, frames - 1);
+    }
     return 0;
 }
 
+static volatile sig_atomic_t stop_recording = 0;
 
+static void on_interrupt(int)
+{
+    stop_recording = 1;
+}
+
+// writes every frame of a source to a recording (recording.h), until the source ends or
+// SIGINT (a camera never ends); frames are stored as the source delivers them (-S, -C)
+int run_record(frame_source *source, const char *path)
+{
+    recording_writer w;
+    if (!open_recording_writer(&w, path, source->scale)) {
+        cout << "cannot create " << path << endl;
+        return -1;
+    }
+    cout << "recording " << source->name << " to " << path << " (ctrl-c to stop)" << endl;
+    signal(SIGINT, on_interrupt);
+    
+    Mat src;
+    int frames = 0;
+    bool ok = true;
+    while (!stop_recording && next_frame(source, src)) {
+        if (!write_frame(&w, source->colour ? source->frame : src, source->captured)) {
+            cout << "frame " << frames << " differs in size from the first (or can't be written), stopping" << endl;
+            ok = false;
+            break;
+        }
+        frames++;
+    }
+    signal(SIGINT, SIG_DFL);
+    double duration = w.index.empty() ? 0 : w.index.back().captured;
+    if (!close_recording_writer(&w)) {
+        cout << "cannot write " << path << endl;
+        return -1;
+    }
+    cout << "frames:     " << frames << " (" << w.header.width << "x" << w.header.height << "x"
+         << w.header.channels << ")" << endl;
+    cout << "duration:   " << duration << " s" << endl;
+    return ok ? 0 : -1;
+}
+
+// runs the Canny + HoughLinesP pipeline over a large image band by band (-B)
+//  there is no output image: the overlay would need the whole frame in memory
+int run_bands(const char *filename, int band_rows, const run_options *opts)
+{
+    band_source src;
+    if (!open_band_source(&src, filename)) {
+        cout << "cannot open " << filename << endl;
+        return -1;
+    }
+    cout << "running opencv with " << filename << " (" << src.size.width << "x" << src.size.height
+         << ", bands of " << band_rows << " rows)" << endl;
+    
+    detector det;
+    init_detector(&det, find_engine(REFERENCE_ENGINE));
+    band_stats stats;
+    int ret = detect_bands(&src, band_rows, &det, &stats);
+    close_band_source(&src);
+    if (ret != 0)
+        return ret;
+    telemetry_sample sample;
+    const telemetry_sample *reading = frame_telemetry(opts, &sample);
+    if (opts->results != NULL)
+        write_result(opts->results, 0, &det, reading);
+    
+    cout << "bands:      " << stats.bands << endl;
+    cout << "segments:   " << det.segments.size() << endl;
+    cout << "lane lines: " << det.lane_lines.size() << endl;
+    cout << "decode time: " << stats.read_time << " s" << endl;
+    cout << "canny time: " << stats.edge_time << " s" << endl;
+    cout << "hough time: " << stats.segment_time << " s" << endl;
+    cout << "lines time: " << det.model_time << " s" << endl;
+    if (opts->machine != NULL)
+        print_telemetry(opts->machine, 1);
+    return 0;
+}
+
+// runs several streams together on a shared pool of workers, prints per-stream statistics
+int run_multi(const vector<string> &specs, const lane_engine *engine, int workers, bool skip_unchanged,
+              const rt_config *rt, bool colour, bool compare)
+{
+    stream_pool pool;
+    pool.skip_unchanged = skip_unchanged;
+    pool.rt = rt;
+    pool.first_cpu = 0;
+    pool.colour = colour;
+    vector<stream> streams(specs.size());
+    for (size_t i = 0; i < specs.size(); i++) {
+        if (!parse_stream(&streams[i], (int)i, specs[i], engine, colour)) {
+            cout << "cannot open " << specs[i] << endl;
+            return -1;
+        }
+        pool.streams.push_back(&streams[i]);
+    }
+    
+    cout << "running opencv with " << specs.size() << " streams on " << workers
+         << " workers (" << engine->name << ")" << endl;
+    double start = now();
+    if (run_streams(&pool, workers) != 0)
+        return -1;
+    double elapsed = now() - start;
+    print_stream_stats(&pool, elapsed);
+    if (!compare)
+        return 0;
+    
+    int shared = 0;
+    for (size_t i = 0; i < streams.size(); i++)
+        shared += streams[i].frames;
+    double separate_time;
+    int separate = run_separate(specs, engine, workers, &pool, &separate_time);
+    if (separate < 0) {
+        cout << "cannot run the streams in separate processes" << endl;
+        return -1;
+    }
+    double shared_fps = elapsed > 0 ? shared / elapsed : 0;
+    double separate_fps = separate_time > 0 ? separate / separate_time : 0;
+    cout << "separate processes: " << separate << " frames in " << separate_time << " s ("
+         << separate_fps << " fps, " << max(1, workers / (int)specs.size()) << " workers each)" << endl;
+    if (separate_fps > 0)
+        cout << "shared pool: " << shared_fps / separate_fps << "x the throughput of one process per stream" << endl;
+    return 0;
+}
+
+int main (int argc, char * argv[])
+{
+    clock_t start = clock();
+    
+    const lane_engine *engine = find_engine(REFERENCE_ENGINE);
+    bool bench = false;
+    bool skip_unchanged = false;
+    const char *video = NULL;
+    vector<string> stream_specs;
+    bool compare_processes = false;
+    int workers = getNumberOfCPUs();
+    const char *trace_file = NULL;
+    bool jitter = false;
+    const char *socket_path = NULL;
+    const char *results_path = NULL;
+    const char *event_path = NULL;
+    const char *record_path = NULL;
+    bool realtime = false;
+    int prefetch_depth = 0;
+    bool sample_machine = false;
+    int results_format = RESULTS_NDJSON;
+    bool write_image = true;
+    int scale = 1;
+    bool roi_only = false;
+    bool colour = false;
+    int band_rows = 0;
+    int band_check = 0;
+    scene_params scene;
+    init_scene_params(&scene);
+    bool generate = false;
+    bool scaling = false;
+    bool geometry = false;
+    bool mask = false;
+    bool lsd = false;
+    rt_config rt;
+    init_rt_config(&rt);
+    int opt;
+    while ((opt = getopt(argc, argv, "e:buv:s:j:pPc:r:mJd:R:F:nNS:TCB:W:G:XkK:gMLH:E:w:ya:it:")) != -1) {
+        switch (opt) {
+            case 'e':
+                engine = find_engine(optarg);
+                if (engine == NULL) {
+                    cout << "unknown engine " << optarg << endl;
+                    usage(argv[0]);
+                    return -1;
+                }
+                break;
+            case 'b':
+                bench = true;
+                break;
+            case 'u':
+                skip_unchanged = true;
+                break;
+            case 'v':
+                video = optarg;
+                break;
+            case 's':
+                stream_specs.push_back(optarg);
+                break;
+            case 'N':
+                compare_processes = true;
+                break;
+            case 'j':
+                workers = atoi(optarg);
+                break;
+            case 'p':
+                enable_mat_pool(false);
+                break;
+            case 'P':
+                enable_mat_pool(true);
+                break;
+            case 'c':
+                if (!parse_cpu_list(optarg, &rt.cpus)) {
+                    cout << "bad cpu list " << optarg << endl;
+                    return -1;
+                }
+                break;
+            case 'r':
+                if (!parse_sched(optarg, &rt)) {
+                    cout << "bad scheduling policy " << optarg << endl;
+                    return -1;
+                }
+                break;
+            case 'm':
+                rt.lock_memory = true;
+                break;
+            case 'J':
+                jitter = true;
+                break;
+            case 'd':
+                socket_path = optarg;
+                break;
+            case 'R':
+                results_path = optarg;
+                break;
+            case 'F':
+                if (string(optarg) == "bin")
+                    results_format = RESULTS_BINARY;
+                else if (string(optarg) == "ndjson")
+                    results_format = RESULTS_NDJSON;
+                else {
+                    cout << "unknown result format " << optarg << endl;
+                    return -1;
+                }
+                break;
+            case 'n':
+                write_image = false;
+                break;
+            case 'S':
+                scale = atoi(optarg);
+                if (scale != 1 && scale != 2 && scale != 4 && scale != 8) {
+                    cout << "scale must be 1, 2, 4 or 8" << endl;
+                    return -1;
+                }
+                break;
+            case 'T':
+                roi_only = true;
+                break;
+            case 'C':
+                colour = true;
+                break;
+            case 'B':
+                band_rows = atoi(optarg);
+                break;
+            case 'W':
+                band_check = atoi(optarg);
+                break;
+            case 'G':
+                if (!parse_scene(optarg, &scene)) {
+                    cout << "bad scene " << optarg << endl;
+                    return -1;
+                }
+                generate = true;
+                break;
+            case 'X':
+                scaling = true;
+                break;
+            case 'g':
+                geometry = true;
+                break;
+            case 'M':
+                mask = true;
+                break;
+            case 'L':
+                lsd = true;
+                break;
+            case 'H':
+                if (!parse_hough_budget(optarg)) {
+                    cout << "bad hough budget " << optarg << endl;
+                    return -1;
+                }
+                break;
+            case 'E':
+                event_path = optarg;
+                break;
+            case 'w':
+                record_path = optarg;
+                break;
+            case 'y':
+                realtime = true;
+                break;
+            case 'a':
+                prefetch_depth = atoi(optarg);
+                break;
+            case 'i':
+                sample_machine = true;
+                break;
+            case 'k':
+                enable_stage_cache(NULL);
+                break;
+            case 'K':
+                enable_stage_cache(optarg);
+                break;
+            case 't':
+                trace_file = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return -1;
+        }
+    }
+    
+    if (!stream_specs.empty() && results_path != NULL) {
+        cout << "-R can't be used with -s (streams write no per-frame records)" << endl;
+        return -1;
+    }
+    
+    vector<string> files(argv + optind, argv + argc);
+    if (files.empty())
+        files.push_back("images/road3.png");
+    
+    if (trace_file != NULL)
+        start_trace();
+    
+    // images and sequences run in the main thread (streams apply -c/-r per worker,
+    // the jitter benchmark applies them itself)
+    //  with -c/-r/-m OpenCV's own threads are turned off (they wouldn't be pinned or real-time),
+    //  so the whole frame runs in the tuned thread
+    if (!bench && !jitter && !scaling && !geometry && !mask && !lsd && band_check == 0 && stream_specs.empty()) {
+        if (rt_enabled(&rt))
+            setNumThreads(0);
+        apply_process_rt(&rt);
+        apply_thread_rt(&rt, 0);
+    }
+    
+    run_options opts;
+    opts.engine = engine;
+    opts.skip_unchanged = skip_unchanged;
+    opts.write_image = write_image;
+    opts.results = NULL;
+    opts.scale = scale;
+    opts.roi_only = roi_only;
+    opts.colour = colour || engine->colour;
+    opts.events = NULL;
+    departure_state events;
+    if (event_path != NULL) {
+        if (!open_departure(&events, event_path)) {
+            cout << "cannot create event socket: " << strerror(errno) << endl;
+            return -1;
+        }
+        opts.events = &events;
+    }
+    opts.machine = NULL;
+    telemetry machine;
+    if (sample_machine) {
+        if (!open_telemetry(&machine))
+            cout << "no telemetry readings on this machine" << endl;
+        opts.machine = &machine;
+    }
+    if (results_path != NULL) {
+        // records go to stdout: move the messages to stderr so they don't mix
+        if (strcmp(results_path, "-") == 0)
+            cout.rdbuf(cerr.rdbuf());
+        opts.results = new result_writer;
+        if (!open_results(opts.results, results_path, results_format))
+            return -1;
+    }
+    
+    int ret;
+    if (socket_path != NULL)
+        ret = run_daemon(socket_path, engine);
+    else if (geometry)
+        ret = benchmark_geometry(files);
+    else if (mask)
+        ret = benchmark_mask(files);
+    else if (lsd)
+        ret = benchmark_lsd(files);
+    else if (scaling)
+        ret = benchmark_scaling(&scene);
+    else if (generate)
+        ret = generate_scenes(&scene, "images");
+    else if (band_check > 0)
+        ret = benchmark_bands(band_check, band_rows > 0 ? band_rows : BAND_ROWS);
+    else if (band_rows > 0)
+        ret = run_bands(files[0].c_str(), band_rows, &opts);
+    else if (bench)
+        ret = benchmark_engines(files);
+    else if (jitter)
+        ret = benchmark_jitter(files[0], engine, &rt);
+    else if (!stream_specs.empty())
+        ret = run_multi(stream_specs, engine, workers, skip_unchanged, &rt, opts.colour, compare_processes);
+    else if (video != NULL || files.size() > 1 || record_path != NULL) {
+        frame_source source;
+        prefetcher prefetch;
+        if (video != NULL) {
+            if (!open_source(&source, video)) {
+                cout << "cannot open " << video << endl;
+                return -1;
+            }
+        }
+        else
+            open_image_list(&source, files);
+        if (video == NULL && prefetch_depth > 0) {
+            start_prefetch(&prefetch, files, prefetch_depth);
+            source.prefetch = &prefetch;
+        }
+        if (source.replay.data != NULL) {
+            // a recording's frames were decoded when it was made (at its -S scale): -S and -T
+            //  don't apply again, and results are rescaled by the recording's own scale
+            if (scale != 1 || roi_only)
+                cout << "-S/-T ignored: " << video << " was recorded at 1/" << recorded_scale(&source.replay) << endl;
+            scale = opts.scale = recorded_scale(&source.replay);
+            roi_only = opts.roi_only = false;
+        }
+        source.scale = scale;
+        source.roi_only = roi_only;
+        source.colour = opts.colour;
+        source.realtime = realtime;
+        if (record_path != NULL)
+            ret = run_record(&source, record_path);
+        else
+            ret = run_sequence(&source, &opts);
+        if (source.prefetch != NULL)
+            stop_prefetch(&prefetch);
+        close_source(&source);
+    }
+    else
+        ret = run_image(files[0].c_str(), &opts, start);
+    
+    if (opts.results != NULL) {
+        close_results(opts.results);
+        delete opts.results;
+    }
+    if (opts.events != NULL)
+        close_departure(opts.events);
+    if (opts.machine != NULL)
+        close_telemetry(opts.machine);
+    if (trace_file != NULL)
+        write_trace(trace_file);
+    if (stage_cache_enabled())
+        print_cache_stats();
+    cout << "\ndone" << endl;
+    
+    
+    return ret;
+}
@@ -0,0 +1,102 @@
+//
+//  paint.cpp
+//  opencv
+//
+
+#include "paint.h"
+#include <opencv2/core/hal/intrin.hpp>
+
+// the named intrinsics (v_ge, v_and, ...) are used from OpenCV 4.9 on, which deprecates the
+// operators on vector types (5.x drops them); before that only the operators are sure to
+// exist (4.6-4.8 have the names too, so shims of our own would make the calls ambiguous)
+#define NAMED_INTRINSICS (CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && CV_VERSION_MINOR >= 9))
+
+// brightness a paint pixel needs on a road of this level
+static int paint_threshold(int level)
+{
+    return min(max(level + PAINT_CONTRAST, PAINT_FLOOR), 255);
+}
+
+// median of every 4th pixel of every 4th row below the middle of the frame
+//  (the sky is excluded the same way remove_skylines() excludes its lines)
+int road_level(const Mat &gray)
+{
+    int hist[256] = { 0 };
+    int count = 0;
+    for (int y = gray.rows / 2; y < gray.rows; y += 4) {
+        const uchar *p = gray.ptr<uchar>(y);
+        for (int x = 0; x < gray.cols; x += 4) {
+            hist[p[x]]++;
+            count++;
+        }
+    }
+    int level = 0;
+    for (int seen = 0; level < 255; level++) {
+        seen += hist[level];
+        if (2 * seen >= count)
+            break;
+    }
+    return level;
+}
+
+// classifies every pixel of a BGR frame as white paint (bright and grey), yellow paint
+// (bright red and green, little blue) or not paint, in a single pass over the frame
+//  16 pixels at a time with OpenCV's universal intrinsics (SSE2 on x86, NEON on ARM);
+//  unsigned saturating arithmetic, so hi - lo and min(r,g) - b never wrap
+void paint_mask(const Mat &bgr, int level, Mat &mask)
+{
+    CV_Assert(bgr.type() == CV_8UC3);
+    mask.create(bgr.size(), CV_8UC1);
+    int t = paint_threshold(level);
+    
+    for (int y = 0; y < bgr.rows; y++) {
+        const uchar *p = bgr.ptr<uchar>(y);
+        uchar *m = mask.ptr<uchar>(y);
+        int x = 0;
+#if CV_SIMD128
+        v_uint8x16 vt = v_setall_u8((uchar)t);
+        v_uint8x16 vchroma = v_setall_u8((uchar)WHITE_CHROMA);
+        v_uint8x16 vmargin = v_setall_u8((uchar)YELLOW_MARGIN);
+        for (; x <= bgr.cols - 16; x += 16) {
+            v_uint8x16 b, g, r;
+            v_load_deinterleave(p + 3*x, b, g, r);
+            v_uint8x16 lo = v_min(v_min(b, g), r);
+            v_uint8x16 hi = v_max(v_max(b, g), r);
+            v_uint8x16 rg = v_min(r, g);
+#if NAMED_INTRINSICS
+            v_uint8x16 white = v_and(v_ge(lo, vt), v_le(v_sub(hi, lo), vchroma));
+            v_uint8x16 yellow = v_and(v_ge(rg, vt), v_ge(v_sub(rg, b), vmargin));
+            v_store(m + x, v_or(white, yellow));
+#else
+            v_uint8x16 white = (lo >= vt) & ((hi - lo) <= vchroma);
+            v_uint8x16 yellow = (rg >= vt) & ((rg - b) >= vmargin);
+            v_store(m + x, white | yellow);
+#endif
+        }
+#endif
+        for (; x < bgr.cols; x++) {
+            int b = p[3*x], g = p[3*x + 1], r = p[3*x + 2];
+            int lo = min(min(b, g), r), hi = max(max(b, g), r), rg = min(r, g);
+            bool white = lo >= t && hi - lo <= WHITE_CHROMA;
+            bool yellow = rg >= t && rg - b >= YELLOW_MARGIN;
+            m[x] = (white || yellow) ? 255 : 0;
+        }
+    }
+}
+
+// keeps only the edges on or next to paint
+//  frame is the colour frame gray was taken from; if there is none (gray sources: the
+//  daemon, streams) only brightness can be checked, so white paint is kept and yellow
+//  paint only where it is bright enough
+void apply_paint_mask(const Mat &frame, const Mat &gray, Mat &mask, Mat &edges)
+{
+    int level = road_level(gray);
+    if (frame.type() == CV_8UC3 && frame.size() == gray.size())
+        paint_mask(frame, level, mask);
+    else
+        compare(gray, paint_threshold(level), mask, CMP_GE);
+    
+    int k = 2*PAINT_DILATE + 1;
+    dilate(mask, mask, getStructuringElement(MORPH_RECT, Size(k, k)));
+    bitwise_and(edges, mask, edges);
+}
@@ -0,0 +1,30 @@
+//
+//  paint.h
+//  opencv
+//
+//  lane-paint mask: pixels that look like white or yellow road paint, computed from
+//  the colour frame in one vectorized pass, to prune the Canny edges HoughLinesP votes on
+//  (shadows, cars and guard rails have strong edges but aren't paint-coloured)
+
+#ifndef opencv_paint_h
+#define opencv_paint_h
+
+#include "project.h"
+
+// paint is judged against the road itself rather than a fixed level, so dim frames keep
+// their markings: a pixel is paint if it is this much brighter than the road level
+// (median luma of the lower half of the frame), and never darker than PAINT_FLOOR
+const int PAINT_CONTRAST = 50;              // how much brighter than the road paint is
+const int PAINT_FLOOR = 120;                // darkest a paint pixel can be
+const int WHITE_CHROMA = 60;                // white: max - min of b,g,r at most this (grey, not coloured)
+const int YELLOW_MARGIN = 40;               // yellow: blue at least this far below red and green
+
+// the mask is grown by this many px before the AND, since Canny puts an edge on
+// either side of the paint boundary
+const int PAINT_DILATE = 1;
+
+int road_level(const Mat &);                        // median luma of the lower half of a grayscale frame
+void paint_mask(const Mat &, int, Mat &);           // BGR frame + road level -> 255 where white/yellow paint
+void apply_paint_mask(const Mat &, const Mat &, Mat &, Mat &); // colour frame, its luma, mask buffer: edges &= dilated mask
+
+#endif
@@ -0,0 +1,228 @@
+//
+//  pool.cpp
+//  opencv
+//
+
+#include "pool.h"
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <new>
+
+static pool_allocator mat_pool;
+static bool pool_enabled = false;
+
+// size class of a buffer: 2D images by rows, cols and type, anything else by byte count
+static uint64_t size_class(int dims, const int *sizes, int type, size_t bytes)
+{
+    if (dims == 2)
+        return ((uint64_t)sizes[0] << 40) | ((uint64_t)sizes[1] << 16) | (uint64_t)type;
+    return (1ULL << 63) | bytes;
+}
+
+pool_allocator::pool_allocator()
+{
+    huge_pages = false;
+    counters.allocs = counters.reuses = counters.bytes = counters.faults = 0;
+    idle_bytes = 0;
+    ticks = 0;
+    pthread_mutex_init(&lock, NULL);
+}
+
+// gets fresh memory for a buffer (only on a free-list miss)
+pool_buffer pool_allocator::new_buffer(size_t bytes) const
+{
+    pool_buffer buf;
+    buf.bytes = bytes;
+    buf.mapped = false;
+    buf.data = NULL;
+    
+    if (huge_pages && bytes >= HUGE_PAGE_SIZE) {
+        size_t rounded = (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+        void *p = mmap(NULL, rounded, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED) {
+            buf.data = (uchar *)p;
+            buf.bytes = rounded;
+            buf.mapped = true;
+            return buf;
+        }
+        // no reserved huge pages: ask for transparent huge pages on an aligned buffer instead
+        void *q = NULL;
+        if (posix_memalign(&q, HUGE_PAGE_SIZE, bytes) == 0) {
+            madvise(q, bytes, MADV_HUGEPAGE);
+            buf.data = (uchar *)q;
+            return buf;
+        }
+    }
+    
+    void *p = NULL;
+    if (posix_memalign(&p, POOL_ALIGN, bytes) == 0)
+        buf.data = (uchar *)p;
+    return buf;
+}
+
+static void free_buffer(const pool_buffer &buf)
+{
+    if (buf.mapped)
+        munmap(buf.data, buf.bytes);
+    else
+        free(buf.data);
+}
+
+// gives idle buffers back to the system until at most limit bytes are left, oldest size
+// class first (must hold the lock); a class whose last buffer goes is dropped
+void pool_allocator::trim(size_t limit) const
+{
+    while (idle_bytes > limit) {
+        map<uint64_t, pool_class>::iterator oldest = free_lists.end();
+        for (map<uint64_t, pool_class>::iterator it = free_lists.begin(); it != free_lists.end(); ++it)
+            if (!it->second.idle.empty() && (oldest == free_lists.end() || it->second.used < oldest->second.used))
+                oldest = it;
+        if (oldest == free_lists.end())
+            break;
+        vector<pool_buffer> &idle = oldest->second.idle;
+        free_buffer(idle.front());          // the one idle longest
+        idle_bytes -= idle.front().bytes;
+        idle.erase(idle.begin());
+        if (idle.empty())
+            free_lists.erase(oldest);
+    }
+}
+
+// same step layout as OpenCV's standard allocator; only where the memory comes from differs
+UMatData *pool_allocator::allocate(int dims, const int *sizes, int type, void *data,
+                                   size_t *step, access_flag flags, UMatUsageFlags usage) const
+{
+    size_t total = CV_ELEM_SIZE(type);
+    for (int i = dims-1; i >= 0; i--) {
+        if (step) {
+            if (data && step[i] != CV_AUTOSTEP) {
+                CV_Assert(total <= step[i]);
+                total = step[i];
+            }
+            else
+                step[i] = total;
+        }
+        total *= sizes[i];
+    }
+    
+    pthread_mutex_lock(&lock);
+    
+    UMatData *u;
+    if (!free_headers.empty()) {
+        u = free_headers.back();
+        free_headers.pop_back();
+        new (u) UMatData(this);
+    }
+    else
+        u = new UMatData(this);
+    
+    if (data) {
+        u->data = u->origdata = (uchar *)data;
+        u->flags |= UMatData::USER_ALLOCATED;
+    }
+    else {
+        pool_class &cls = free_lists[size_class(dims, sizes, type, total)];
+        vector<pool_buffer> &list = cls.idle;
+        cls.used = ++ticks;
+        pool_buffer buf;
+        if (!list.empty()) {
+            buf = list.back();
+            list.pop_back();
+            idle_bytes -= buf.bytes;
+            counters.reuses++;
+        }
+        else {
+            buf = new_buffer(total);
+            if (buf.data == NULL) {
+                free_headers.push_back(u);
+                pthread_mutex_unlock(&lock);
+                CV_Error(Error::StsNoMem, "pool_allocator: out of memory");
+            }
+            counters.allocs++;
+            counters.bytes += buf.bytes;
+        }
+        // remember the buffer in the UMatData itself (no lookup table to allocate into)
+        u->data = u->origdata = buf.data;
+        u->handle = (void *)buf.bytes;
+        u->allocatorFlags_ = buf.mapped;
+    }
+    u->size = total;
+    u->userdata = (void *)size_class(dims, sizes, type, total);
+    
+    pthread_mutex_unlock(&lock);
+    return u;
+}
+
+bool pool_allocator::allocate(UMatData *, access_flag, UMatUsageFlags) const
+{
+    return false;   // nothing to do for host memory (same as OpenCV's standard allocator)
+}
+
+// returns the buffer (and the UMatData) to the pool; past POOL_MAX_IDLE idle bytes the
+// classes used longest ago are trimmed (this buffer only if nothing older is idle)
+void pool_allocator::deallocate(UMatData *u) const
+{
+    if (u == NULL)
+        return;
+    CV_Assert(u->urefcount == 0);
+    CV_Assert(u->refcount == 0);
+    
+    pthread_mutex_lock(&lock);
+    if (!(u->flags & UMatData::USER_ALLOCATED)) {
+        pool_buffer buf;
+        buf.data = u->origdata;
+        buf.bytes = (size_t)u->handle;
+        buf.mapped = u->allocatorFlags_ != 0;
+        pool_class &cls = free_lists[(uint64_t)u->userdata];
+        cls.idle.push_back(buf);
+        cls.used = ++ticks;
+        idle_bytes += buf.bytes;
+        trim(POOL_MAX_IDLE);
+        u->origdata = 0;
+    }
+    u->~UMatData();
+    free_headers.push_back(u);
+    pthread_mutex_unlock(&lock);
+}
+
+// ===================================================================
+// setup and accounting
+// ===================================================================
+
+void enable_mat_pool(bool huge_pages)
+{
+    mat_pool.huge_pages = huge_pages;
+    Mat::setDefaultAllocator(&mat_pool);
+    pool_enabled = true;
+}
+
+bool mat_pool_enabled()
+{
+    return pool_enabled;
+}
+
+void get_alloc_counters(alloc_counters *c)
+{
+    *c = mat_pool.counters;
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    c->faults = usage.ru_minflt + usage.ru_majflt;
+}
+
+void alloc_delta(const alloc_counters *a, const alloc_counters *b, alloc_counters *d)
+{
+    d->allocs = b->allocs - a->allocs;
+    d->reuses = b->reuses - a->reuses;
+    d->bytes = b->bytes - a->bytes;
+    d->faults = b->faults - a->faults;
+}
+
+void print_allocs(const char *label, const alloc_counters *d, int frames)
+{
+    if (frames <= 0)
+        return;
+    cout << label << (double)d->allocs / frames << " new buffers ("
+         << (double)d->bytes / frames / 1024 << " KiB), " << (double)d->reuses / frames
+         << " reused, " << (double)d->faults / frames << " page faults per frame" << endl;
+}
@@ -0,0 +1,82 @@
+//
+//  pool.h
+//  opencv
+//
+//  pooled allocator for cv::Mat buffers:
+//  every frame allocates the same handful of images (edge map, 3-channel copy,
+//  blended overlay, ...), so buffers are kept in free lists keyed by resolution
+//  and type and handed back out on the next frame instead of going to the heap
+//
+//  buffers are 64-byte aligned (cache line / SIMD loads), and can optionally be
+//  backed by huge pages to cut TLB misses and page faults on big frames
+//
+//  idle buffers are kept up to POOL_MAX_IDLE bytes in all; past that the size classes
+//  used longest ago give theirs back, so sizes that stop coming up (another -S scale,
+//  a different image size, a daemon request) don't hold memory for the rest of the run
+
+#ifndef opencv_pool_h
+#define opencv_pool_h
+
+#include "project.h"
+#include <pthread.h>
+#include <map>
+
+const size_t POOL_ALIGN = 64;               // alignment of every buffer (in bytes)
+const size_t HUGE_PAGE_SIZE = 2 << 20;      // buffers at least this big may use huge pages
+const size_t POOL_MAX_IDLE = 256 << 20;     // bytes of idle buffers kept for reuse
+
+// OpenCV 4 changed the type of the access flags in MatAllocator
+#if CV_VERSION_MAJOR >= 4
+typedef AccessFlag access_flag;
+#else
+typedef int access_flag;
+#endif
+
+// running totals (never reset; subtract two snapshots for a frame's share)
+struct alloc_counters {
+    long allocs;                            // buffers that had to come from the heap/mmap
+    long reuses;                            // buffers handed out again from a free list
+    long bytes;                             // bytes of fresh buffers
+    long faults;                            // page faults of the process (minor + major)
+};
+
+struct pool_buffer {
+    uchar *data;
+    size_t bytes;
+    bool mapped;                            // true: mmap()ed huge pages, false: posix_memalign()
+};
+
+struct pool_class {
+    vector<pool_buffer> idle;               // buffers of this size class waiting for reuse
+    long used;                              // pool tick of the last allocation/release in it
+};
+
+class pool_allocator : public MatAllocator {
+public:
+    pool_allocator();
+    
+    UMatData *allocate(int, const int *, int, void *, size_t *, access_flag, UMatUsageFlags) const;
+    bool allocate(UMatData *, access_flag, UMatUsageFlags) const;
+    void deallocate(UMatData *) const;
+    
+    bool huge_pages;                        // back big buffers with huge pages
+    mutable alloc_counters counters;
+    
+private:
+    mutable pthread_mutex_t lock;
+    mutable map<uint64_t, pool_class> free_lists;              // size class -> idle buffers
+    mutable vector<UMatData *> free_headers;                    // UMatData kept for reuse
+    mutable size_t idle_bytes;                                  // in all the free lists
+    mutable long ticks;                                         // allocations + releases so far
+    
+    pool_buffer new_buffer(size_t) const;
+    void trim(size_t) const;                                    // frees idle buffers down to a total
+};
+
+void enable_mat_pool(bool);                 // makes the pool the default allocator of every Mat
+bool mat_pool_enabled();
+void get_alloc_counters(alloc_counters *);  // snapshot of the pool's counters + page faults
+void alloc_delta(const alloc_counters *, const alloc_counters *, alloc_counters *);   // b - a
+void print_allocs(const char *, const alloc_counters *, int);   // per-frame averages of a delta
+
+#endif
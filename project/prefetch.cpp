@@ -0,0 +1,225 @@
+//
+//  prefetch.cpp
+//  opencv
+//
+
+#include "prefetch.h"
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+
+// opens a slot's file and makes its buffer big enough; false if the file can't be opened
+// or is empty (nothing to decode)
+static bool open_slot(prefetcher *p, prefetch_slot *s)
+{
+    struct stat st;
+    s->fd = open(p->files[s->file].c_str(), O_RDONLY);
+    if (s->fd >= 0 && fstat(s->fd, &st) == 0 && st.st_size > 0) {
+        s->size = st.st_size;
+        if (s->buf.size() < s->size)
+            s->buf.resize(s->size);
+        return true;
+    }
+    if (s->fd >= 0)
+        close(s->fd);
+    s->fd = -1;
+    return false;
+}
+
+// reads the rest of a slot's file from byte from on, with pread(), and closes it
+static bool finish_slot(prefetch_slot *s, size_t from)
+{
+    ssize_t n = 1;
+    while (from < s->size && n > 0) {
+        n = pread(s->fd, &s->buf[from], s->size - from, from);
+        if (n > 0)
+            from += n;
+    }
+    close(s->fd);
+    s->fd = -1;
+    return from == s->size;
+}
+
+// fallback reader thread: reads queued slots, the earliest file first (the one the
+// decoder will ask for next), until stop_prefetch()
+static void *reader(void *arg)
+{
+    prefetcher *p = (prefetcher *)arg;
+    pthread_mutex_lock(&p->lock);
+    while (!p->stopping) {
+        prefetch_slot *s = NULL;
+        for (size_t i = 0; i < p->slots.size(); i++)
+            if (p->slots[i].state == SLOT_QUEUED && (s == NULL || p->slots[i].file < s->file))
+                s = &p->slots[i];
+        if (s == NULL) {
+            pthread_cond_wait(&p->queued, &p->lock);
+            continue;
+        }
+        // the slot is this thread's until it is marked done
+        s->state = SLOT_READING;
+        pthread_mutex_unlock(&p->lock);
+        bool ok = open_slot(p, s) && finish_slot(s, 0);
+        pthread_mutex_lock(&p->lock);
+        s->state = ok ? SLOT_READY : SLOT_FAILED;
+        if (ok)
+            p->bytes += s->size;
+        pthread_cond_broadcast(&p->done);
+    }
+    pthread_mutex_unlock(&p->lock);
+    return NULL;
+}
+
+#ifdef HAVE_LIBURING
+// submits one read of a slot's whole file; the open itself is synchronous
+static void submit_read(prefetcher *p, prefetch_slot *s)
+{
+    io_uring_sqe *sqe = open_slot(p, s) ? io_uring_get_sqe(&p->ring) : NULL;
+    if (sqe == NULL) {                      // (no free entry can't happen: one per slot)
+        if (s->fd >= 0)
+            close(s->fd);
+        s->fd = -1;
+        s->state = SLOT_FAILED;
+        return;
+    }
+    io_uring_prep_read(sqe, s->fd, &s->buf[0], s->size, 0);
+    io_uring_sqe_set_data(sqe, s);
+    io_uring_submit(&p->ring);
+    s->state = SLOT_READING;
+}
+
+// waits for one read to complete; a short or failed read is finished with pread()
+static void reap_read(prefetcher *p)
+{
+    io_uring_cqe *cqe;
+    int err;
+    while ((err = io_uring_wait_cqe(&p->ring, &cqe)) == -EINTR)
+        ;
+    if (err < 0) {
+        // the ring is broken: fail whatever it still holds
+        for (size_t i = 0; i < p->slots.size(); i++)
+            if (p->slots[i].state == SLOT_READING) {
+                close(p->slots[i].fd);
+                p->slots[i].fd = -1;
+                p->slots[i].state = SLOT_FAILED;
+            }
+        return;
+    }
+    prefetch_slot *s = (prefetch_slot *)io_uring_cqe_get_data(cqe);
+    int res = cqe->res;
+    io_uring_cqe_seen(&p->ring, cqe);
+    bool ok = finish_slot(s, res > 0 ? res : 0);
+    s->state = ok ? SLOT_READY : SLOT_FAILED;
+    if (ok)
+        p->bytes += s->size;
+}
+#endif
+
+// gives free slots their next files, in order (called with the lock held)
+static void queue_next(prefetcher *p)
+{
+    while (p->next < p->files.size()) {
+        prefetch_slot *s = &p->slots[p->next % p->depth];
+        if (s->state != SLOT_FREE)
+            break;
+        s->file = p->next++;
+#ifdef HAVE_LIBURING
+        if (p->uring) {
+            submit_read(p, s);
+            continue;
+        }
+#endif
+        s->state = SLOT_QUEUED;
+        pthread_cond_signal(&p->queued);
+    }
+}
+
+void start_prefetch(prefetcher *p, const vector<string> &files, int depth)
+{
+    p->files = files;
+    p->depth = max(depth, 1);
+    p->next = 0;
+    p->slots.assign(p->depth, prefetch_slot());
+    for (int i = 0; i < p->depth; i++) {
+        p->slots[i].state = SLOT_FREE;
+        p->slots[i].fd = -1;
+    }
+    p->wait_time = 0;
+    p->bytes = 0;
+    p->stopping = false;
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->queued, NULL);
+    pthread_cond_init(&p->done, NULL);
+    
+    p->uring = false;
+#ifdef HAVE_LIBURING
+    p->uring = io_uring_queue_init(p->depth, &p->ring, 0) == 0;
+#endif
+    if (!p->uring) {
+        p->threads.resize(min(PREFETCH_THREADS, p->depth));
+        for (size_t i = 0; i < p->threads.size(); i++)
+            if (pthread_create(&p->threads[i], NULL, reader, p) != 0) {
+                p->threads.resize(i);
+                break;
+            }
+    }
+    pthread_mutex_lock(&p->lock);
+    queue_next(p);
+    pthread_mutex_unlock(&p->lock);
+}
+
+bool take_file(prefetcher *p, size_t i, Mat &bytes)
+{
+    prefetch_slot *s = &p->slots[i % p->depth];
+    double start = now();
+    pthread_mutex_lock(&p->lock);
+    bool queued = s->file == i && s->state != SLOT_FREE;
+    while (queued && (s->state == SLOT_QUEUED || s->state == SLOT_READING)) {
+#ifdef HAVE_LIBURING
+        if (p->uring) {
+            reap_read(p);
+            continue;
+        }
+#endif
+        pthread_cond_wait(&p->done, &p->lock);
+    }
+    bool ok = queued && s->state == SLOT_READY;
+    if (ok)
+        bytes = Mat(1, (int)s->size, CV_8UC1, &s->buf[0]);
+    pthread_mutex_unlock(&p->lock);
+    p->wait_time += now() - start;
+    return ok;
+}
+
+void release_file(prefetcher *p, size_t i)
+{
+    prefetch_slot *s = &p->slots[i % p->depth];
+    pthread_mutex_lock(&p->lock);
+    if (s->file == i && (s->state == SLOT_READY || s->state == SLOT_FAILED))
+        s->state = SLOT_FREE;
+    queue_next(p);
+    pthread_mutex_unlock(&p->lock);
+}
+
+void stop_prefetch(prefetcher *p)
+{
+    pthread_mutex_lock(&p->lock);
+    p->stopping = true;
+    pthread_cond_broadcast(&p->queued);
+    pthread_mutex_unlock(&p->lock);
+    for (size_t i = 0; i < p->threads.size(); i++)
+        pthread_join(p->threads[i], NULL);
+    p->threads.clear();
+#ifdef HAVE_LIBURING
+    if (p->uring) {
+        // the kernel may still write into the buffers until the reads complete
+        for (size_t i = 0; i < p->slots.size(); i++)
+            while (p->slots[i].state == SLOT_READING)
+                reap_read(p);
+        io_uring_queue_exit(&p->ring);
+    }
+#endif
+    pthread_mutex_destroy(&p->lock);
+    pthread_cond_destroy(&p->queued);
+    pthread_cond_destroy(&p->done);
+}
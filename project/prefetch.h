@@ -0,0 +1,69 @@
+//
+//  prefetch.h
+//  opencv
+//
+//  read-ahead of an image list: the next few files are read into memory while the
+//  current one is decoded and processed, so decoding (imdecode, from the bytes) only
+//  waits for the disk when the reads fall behind - and the time it waits is counted
+//  apart from the decoding
+//
+//  with -DHAVE_LIBURING the reads are io_uring submissions (no threads); otherwise, or
+//  if the kernel refuses a ring, PREFETCH_THREADS reader threads use pread(); file i is
+//  read into slot i % depth, whose buffer is kept for the later files of that slot (grown
+//  when a file doesn't fit), so steady state reads allocate nothing
+
+#ifndef opencv_prefetch_h
+#define opencv_prefetch_h
+
+#include "project.h"
+#include <pthread.h>
+
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+const int PREFETCH_DEPTH = 8;               // default number of files read ahead (in flight)
+const int PREFETCH_THREADS = 4;             // reader threads of the fallback (at most depth)
+
+// slot states
+enum {
+    SLOT_FREE,                              // no file
+    SLOT_QUEUED,                            // file waiting for a reader thread
+    SLOT_READING,                           // read submitted / in a reader thread
+    SLOT_READY,                             // bytes in buf
+    SLOT_FAILED                             // file can't be opened or read
+};
+
+struct prefetch_slot {
+    size_t file;                            // index of the file in the slot
+    int state;
+    vector<uchar> buf;                      // reused from file to file
+    size_t size;                            // bytes of the file in buf
+    int fd;                                 // io_uring: file being read (-1 if none)
+};
+
+struct prefetcher {
+    vector<string> files;
+    int depth;                              // files in flight
+    size_t next;                            // next file to give a slot
+    vector<prefetch_slot> slots;
+    double wait_time;                       // time take_file() waited for reads (s)
+    double bytes;                           // bytes read
+    bool uring;                             // reads go through ring (else threads)
+#ifdef HAVE_LIBURING
+    io_uring ring;
+#endif
+    vector<pthread_t> threads;
+    pthread_mutex_t lock;
+    pthread_cond_t queued;                  // a slot was queued (or stopping set)
+    pthread_cond_t done;                    // a read finished
+    bool stopping;
+};
+
+void start_prefetch(prefetcher *, const vector<string> &, int);  // files, depth; starts reading the first ones
+bool take_file(prefetcher *, size_t, Mat &);    // bytes of file i (1 x size CV_8UC1 in the slot's buffer),
+                                                //  waiting for the read; false if it can't be read
+void release_file(prefetcher *, size_t);        // done with file i: its slot starts on file i + depth
+void stop_prefetch(prefetcher *);               // waits for reads in flight, stops the threads
+
+#endif
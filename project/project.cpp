@@ -6,176 +6,91 @@
 #include "project.h"
 
 // ===================================================================
-// draw_lane() - to draw the actual lanes in between lines
+// lane index, and draw_lanes() - to draw the actual lanes in between lines
 // ===================================================================
 
-// finds a middle line, and draws a polygon from the leftmost to middle and from rightmost to middle
-// assumes "american" style roads (drive in right, oncoming on left)
-// polgyon point format:
-//  topleft, bottomleft, bottomright, topright
-Mat draw_2lanes(Mat src, vector<Vec4i> lines)
+// one insertion sort by x at the bottom row (a frame has a handful of lane lines), then the
+// car's lane: the one under the middle of the bottom row, or else the rightmost
+// (oncoming traffic is on the left)
+void build_lane_index(lane_index *index, const vector<Vec4i> &lines, Size size)
 {
-    Mat lanes = src, dst;                     // for blending in semi-transparent lanes
-    Vec4i midline = middle_line(lines);
-    Vec4i left = leftmost(lines);
-    Vec4i right = rightmost(lines);
-    
-    int npt[1] = { NUM_VERTICES };      // number of points to draw (must be int[])
-    
-    // create left lane polygon (oncoming traffic lane)
-    // use slope to determine which points are which
-    Point left_pts[1][4];
-    if (slope(left) >= 0) {
-        left_pts[0][0] = Point(left[0]+LANE_EDGE, left[1]);
-        left_pts[0][1] = Point(left[2]+LANE_EDGE, left[3]);
-    }
-    else {
-        left_pts[0][0] = Point(left[2]+LANE_EDGE, left[3]);
-        left_pts[0][1] = Point(left[0]+LANE_EDGE, left[1]);
-    }
-    if (slope(midline) >= 0) {
-        left_pts[0][3] = Point(midline[0]-LANE_EDGE, midline[1]);
-        left_pts[0][2] = Point(midline[2]-LANE_EDGE, midline[3]);
-    }
-    else {
-        left_pts[0][3] = Point(midline[2]-LANE_EDGE, midline[3]);
-        left_pts[0][2] = Point(midline[0]-LANE_EDGE, midline[1]);
-    }
-    const Point * left_ppt[1] = { left_pts[0] };
-    fillPoly(lanes, left_ppt, npt, NUM_POLYGONS, ONCOMING_COLOR, LINE_TYPE);
-    
-    // create right lane polygon (oncoming traffic lane)
-    // use slope to determine which points are which
-    Point right_pts[1][4];
-    if (slope(midline) >= 0) {
-        right_pts[0][0] = Point(midline[0]+LANE_EDGE, midline[1]);
-        right_pts[0][1] = Point(midline[2]+LANE_EDGE, midline[3]);
-    }
-    else {
-        right_pts[0][0] = Point(midline[2]+LANE_EDGE, midline[3]);
-        right_pts[0][1] = Point(midline[0]+LANE_EDGE, midline[1]);
-    }
-    if (slope(right) >= 0) {
-        right_pts[0][3] = Point(right[0]-LANE_EDGE, right[1]);
-        right_pts[0][2] = Point(right[2]-LANE_EDGE, right[3]);
-    }
-    else {
-        right_pts[0][3] = Point(right[2]-LANE_EDGE, right[3]);
-        right_pts[0][2] = Point(right[0]-LANE_EDGE, right[1]);
-    }
-    const Point * right_ppt[1] = { right_pts[0] };
-    fillPoly(lanes, right_ppt, npt, NUM_POLYGONS, THISLANE_COLOR, LINE_TYPE);
-    
-    // should blend the images to make semi-transparent lanes (doesn't work right)
-    addWeighted(lanes, ALPHA, src, 1-ALPHA, 0.0, dst);
-    return dst;
-}
-
-// draws polgyon from leftmost to rightmost lines
-Mat draw_1lane(Mat src, vector<Vec4i> lines)
-{
-    Mat lanes = src, dst;                     // for blending in semi-transparent lanes
-    Vec4i left = leftmost(lines);
-    Vec4i right = rightmost(lines);
-    
-    int npt[1] = { NUM_VERTICES };      // number of points to draw (must be int[])
-    
-    // create left lane polygon (oncoming traffic lane)
-    // use slope to determine which points are which
-    Point pts[1][4];
-    if (slope(left) >= 0) {
-        pts[0][0] = Point(left[0]+LANE_EDGE, left[1]);
-        pts[0][1] = Point(left[2]+LANE_EDGE, left[3]);
-    }
-    else {
-        pts[0][0] = Point(left[2]+LANE_EDGE, left[3]);
-        pts[0][1] = Point(left[0]+LANE_EDGE, left[1]);
-    }
-    if (slope(right) >= 0) {
-        pts[0][3] = Point(right[0]-LANE_EDGE, right[1]);
-        pts[0][2] = Point(right[2]-LANE_EDGE, right[3]);
-    }
-    else {
-        pts[0][3] = Point(right[2]-LANE_EDGE, right[3]);
-        pts[0][2] = Point(right[0]-LANE_EDGE, right[1]);
+    index->lines.clear();
+    index->bottom_x.clear();
+    index->paths.clear();
+    for (size_t i = 0; i < lines.size(); i++) {
+        double x = x_at(lines[i], size.height - 1);
+        size_t k = index->lines.size();
+        index->lines.push_back(lines[i]);
+        index->bottom_x.push_back(x);
+        for (; k > 0 && index->bottom_x[k-1] > x; k--) {
+            index->lines[k] = index->lines[k-1];
+            index->bottom_x[k] = index->bottom_x[k-1];
+        }
+        index->lines[k] = lines[i];
+        index->bottom_x[k] = x;
     }
-    const Point * ppt[1] = { pts[0] };
-    fillPoly(lanes, ppt, npt, NUM_POLYGONS, THISLANE_COLOR, LINE_TYPE);
     
-    // should blend the images to make semi-transparent lanes (doesn't work right)
-    addWeighted(lanes, ALPHA, src, 1-ALPHA, 0.0, dst);
-    return dst;
+    int lanes = num_lanes(index);
+    index->own_lane = lanes - 1;
+    double car_x = size.width / 2.0;
+    for (int i = 0; i < lanes; i++)
+        if (index->bottom_x[i] <= car_x && car_x < index->bottom_x[i+1])
+            index->own_lane = i;
 }
 
-// ------------------------
-// finding lines (middle, leftmost, rightmost)
-
-// finds the "middle" line: always using l[0], first x-point
-// middle line if x point is both less than another's, and greater than another
-Vec4i middle_line(vector<Vec4i> lines)
+int num_lanes(const lane_index *index)
 {
-    for (int i = 0; i < lines.size(); i++) {
-        bool less = false;
-        bool more = false;
-        Vec4i l1 = lines[i];
-        for (int j = 0; j < lines.size(); j++) {
-            if (i == j)
-                continue;   // skip same line
-            Vec4i l2 = lines[j];
-            
-            if (l1[0] < l2[0])
-                less = true;
-            if (l1[2] > l2[2])
-                more = true;
-            
-            if (less && more)
-                return l1;
-        }
-    }
-    // else: (shouldn't happen, there MUST be a middle line)
-    return lines[0];
+    return max((int)index->lines.size() - 1, 0);
 }
 
-// finds the leftmost line (x = min)
-Vec4i leftmost(vector<Vec4i> lines)
+// polgyon point format:
+//  topleft, bottomleft, bottomright, topright
+// each side is moved LANE_EDGE px in from its line
+//  with paths, the left path bottom to top, then the right one top to bottom
+void fill_lanes(Mat &lanes, const lane_index *index)
 {
-    Vec4i left = lines[0];
-    // choose leftmost point
-    int min_x1 = (lines[0])[X1];
-    int min_x2 = (lines[0])[X2];
+    int npt[1] = { NUM_VERTICES };      // number of points to draw (must be int[])
     
-    for (int i = 1; i < lines.size(); i++) {
-        Vec4i l = lines[i];
-        // X1 may be <= because of extend_lines()
-        if (l[X1] <= min_x1 && l[X2] < min_x2) {
-            left = lines[i];
-            min_x1 = l[X1];
-            min_x2 = l[X2];
+    if (!index->paths.empty()) {
+        int n = (int)(index->paths.size() / index->lines.size());
+        vector<Point> pts(2 * n);
+        npt[0] = 2 * n;
+        for (int i = 0; i < num_lanes(index); i++) {
+            const Point *left = &index->paths[i * n], *right = &index->paths[(i+1) * n];
+            for (int k = 0; k < n; k++) {
+                pts[k] = left[k] + Point(LANE_EDGE, 0);
+                pts[2*n - 1 - k] = right[k] - Point(LANE_EDGE, 0);
+            }
+            const Point * ppt[1] = { &pts[0] };
+            fillPoly(lanes, ppt, npt, NUM_POLYGONS, i < index->own_lane ? ONCOMING_COLOR : THISLANE_COLOR, LINE_TYPE);
         }
+        return;
     }
     
-    return left;
+    for (int i = 0; i < num_lanes(index); i++) {
+        Vec4i left = index->lines[i];
+        Vec4i right = index->lines[i+1];
+        // top of a line = the endpoint with the smaller y (0,0 is TOP LEFT)
+        bool left_down = left[Y1] <= left[Y2];
+        bool right_down = right[Y1] <= right[Y2];
+        Point pts[1][4];
+        pts[0][0] = left_down  ? Point(left[X1]+LANE_EDGE, left[Y1])   : Point(left[X2]+LANE_EDGE, left[Y2]);
+        pts[0][1] = left_down  ? Point(left[X2]+LANE_EDGE, left[Y2])   : Point(left[X1]+LANE_EDGE, left[Y1]);
+        pts[0][2] = right_down ? Point(right[X2]-LANE_EDGE, right[Y2]) : Point(right[X1]-LANE_EDGE, right[Y1]);
+        pts[0][3] = right_down ? Point(right[X1]-LANE_EDGE, right[Y1]) : Point(right[X2]-LANE_EDGE, right[Y2]);
+        const Point * ppt[1] = { pts[0] };
+        fillPoly(lanes, ppt, npt, NUM_POLYGONS, i < index->own_lane ? ONCOMING_COLOR : THISLANE_COLOR, LINE_TYPE);
+    }
 }
 
-// finds the rightmost line (x = max)
-Vec4i rightmost(vector<Vec4i> lines)
+Mat draw_lanes(Mat src, const lane_index *index)
 {
-    Vec4i right = lines[0];
-    // choose rightmost point
-    int max_x1 = (lines[0])[X1];
-    int max_x2 = (lines[0])[X2];
-    
-    for (int i = 1; i < lines.size(); i++) {
-        Vec4i l = lines[i];
-        // X2 may be >= because of extend_lines()
-        if (l[X1] > max_x1 && l[X2] >= max_x2) {
-            right = lines[i];
-            max_x1 = l[X1];
-            max_x2 = l[X2];
-        }
-    }
+    Mat lanes = src, dst;                     // for blending in semi-transparent lanes
+    fill_lanes(lanes, index);
     
-    return right;
+    // should blend the images to make semi-transparent lanes (doesn't work right)
+    addWeighted(lanes, ALPHA, src, 1-ALPHA, 0.0, dst);
+    return dst;
 }
 
 
@@ -520,10 +435,25 @@ double x_intercept(Vec4i l)
 {
     return l[X2] - (double)l[Y2]/slope(l);
 }
+// x-coordinate of a (non-horizontal) line at row y
+double x_at(Vec4i l, double y)
+{
+    if (l[Y2] == l[Y1])
+        return mean(l[X1], l[X2]);
+    return l[X1] + (y - l[Y1]) * (l[X2]-l[X1]) / (double)(l[Y2]-l[Y1]);
+}
+
 // gets the mean between two points (to be used with Vec4i points)
 int mean(int a, int b)
 {
     return round((a+b) / 2);
 }
 
+// monotonic wall-clock time in seconds (clock() is cpu time of all threads)
+double now()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
 
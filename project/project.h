@@ -11,17 +11,32 @@
 #include <opencv2/highgui/highgui.hpp>
 #include "opencv2/imgproc/imgproc.hpp"
 #include <iostream>
+#include <time.h>
 
 using namespace cv;
 using namespace std;
 
 // constants for opencv functions (canny, houghlinesp)
+// these and the tolerances below can be overridden from the command line for parameter
+// sweeps, e.g. make PARAMS="-DHLINES_THRESH=50 -DSLOPE_TOLERANCE=0.6"
+#ifndef CANNY_T1
 #define CANNY_T1        175
+#endif
+#ifndef CANNY_T2
 #define CANNY_T2        250
+#endif
+#ifndef CANNY_APERTURE
 #define CANNY_APERTURE  3
+#endif
+#ifndef HLINES_THRESH
 #define HLINES_THRESH   40
+#endif
+#ifndef HLINES_MINLINE
 #define HLINES_MINLINE  70
+#endif
+#ifndef HLINES_MINGAP
 #define HLINES_MINGAP   30
+#endif
 
 // constants for referncing points (x1,y1)(x2,y2) = l1[0,1,2,3]
 #define X1  0
@@ -30,9 +45,17 @@ using namespace std;
 #define Y2  3
 
 // tolerances for determining if two lines are "the same"
+#ifndef HORIZONTAL_TOLERANCE
 const double HORIZONTAL_TOLERANCE = 0.33;    // how far from slope=0 is considered horizontal
-const double POINT_TOLERANCE = 100;          // how close (in px) for two lines to be "equal" (x-intercept)
-const double SLOPE_TOLERANCE = 0.70;         // how close (in %) two lines slopes must be to be "equal"
+#endif
+// (these two are macros, not const doubles, so segment.h can derive its integer template
+//  arguments from them - an override then reaches both the double and fixed-point tests)
+#ifndef POINT_TOLERANCE
+#define POINT_TOLERANCE 100.0                // how close (in px) for two lines to be "equal" (x-intercept)
+#endif
+#ifndef SLOPE_TOLERANCE
+#define SLOPE_TOLERANCE 0.70                 // how close (in %) two lines slopes must be to be "equal"
+#endif
 
 // tolerance for how close to edge to extend to a side of image (in px):
 const int NEAR_EDGE = 100;
@@ -48,12 +71,22 @@ const int LINE_TYPE = 8;                    // line type (8-point)
 const double ALPHA = 0.10;                  // alpha, for blending in semi-transparent lanes
 const Scalar THISLANE_COLOR (255,0,0);      // color of lane photo taken in (blue)  
 const Scalar ONCOMING_COLOR (0,0,255);      // color of lane of oncoming traffic (red)
-// draws the actual lanes in an image
-Mat draw_2lanes(Mat, vector<Vec4i>);       // for more than 1 lane in the photo (3+ lines)
-Mat draw_1lane(Mat, vector<Vec4i>);        // for when there's only 1 lane in the photo (2 lines)
-Vec4i middle_line(vector<Vec4i>);           // returns the "middle" line
-Vec4i leftmost(vector<Vec4i>);              // returns the leftmost line
-Vec4i rightmost(vector<Vec4i>);             // returns the rightmost line
+
+// lane index: the lane lines of a frame ordered left to right by their x at the bottom
+// row, built once per frame; lane i lies between lines[i] and lines[i+1]
+struct lane_index {
+    vector<Vec4i> lines;                    // lane lines, left to right
+    vector<double> bottom_x;                // x of each line at the bottom row
+    int own_lane;                           // lane the car is in, -1 if there are no lanes
+    vector<Point> paths;                    // if the model fitted curves: a polyline per line, bottom to
+                                            //  top, same number of points each, in the order of lines
+};
+void build_lane_index(lane_index *, const vector<Vec4i> &, Size);  // sorts the lines, finds the car's lane (no paths)
+int num_lanes(const lane_index *);          // number of lanes (lines - 1, or 0)
+// draws the actual lanes in an image: the car's lane and those right of it in THISLANE_COLOR,
+// lanes left of it in ONCOMING_COLOR ("american" style roads: drive in right, oncoming on left)
+Mat draw_lanes(Mat, const lane_index *);
+void fill_lanes(Mat &, const lane_index *); // the lane polygons of draw_lanes(), drawn in place
 
 // ---
 // functions to reduce number of lines in image
@@ -77,6 +110,8 @@ bool seperated(Vec4i, Vec4i);               // returns true if l1,l2 are seperat
 double slope(Vec4i);                        // returns slope of the line passed
 double y_intercept(Vec4i);                  // determine y-intercept of line passed
 double x_intercept(Vec4i);                  // determine x-intercept of line passed
+double x_at(Vec4i, double);                 // x of a line at a given y
 int mean(int,int);                          // returns mean between two points
+double now();                               // monotonic wall-clock time (in s)
 
 #endif
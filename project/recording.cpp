@@ -0,0 +1,135 @@
+//
+//  recording.cpp
+//  opencv
+//
+
+#include "recording.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
+
+// ===================================================================
+// writing
+// ===================================================================
+
+// pads the file with zeros up to the next multiple of RECORDING_ALIGN
+static bool align_file(FILE *file)
+{
+    static const char zeros[RECORDING_ALIGN] = { 0 };
+    long pos = ftell(file);
+    long pad = (RECORDING_ALIGN - pos % RECORDING_ALIGN) % RECORDING_ALIGN;
+    return pos >= 0 && fwrite(zeros, 1, pad, file) == (size_t)pad;
+}
+
+bool open_recording_writer(recording_writer *w, const char *path, int scale)
+{
+    memset(&w->header, 0, sizeof(w->header));
+    w->header.scale = scale;
+    w->index.clear();
+    w->first = 0;
+    w->file = fopen(path, "wb");
+    if (w->file == NULL)
+        return false;
+    // placeholder, rewritten by close_recording_writer (frames = 0: incomplete)
+    return fwrite(&w->header, sizeof(w->header), 1, w->file) == 1;
+}
+
+bool write_frame(recording_writer *w, const Mat &frame, double captured)
+{
+    rec_header *h = &w->header;
+    if (frame.depth() != CV_8U || (frame.channels() != 1 && frame.channels() != 3))
+        return false;
+    if (w->index.empty()) {
+        h->width = frame.cols;
+        h->height = frame.rows;
+        h->channels = frame.channels();
+        w->first = captured;
+    }
+    else if (frame.cols != (int)h->width || frame.rows != (int)h->height || frame.channels() != (int)h->channels)
+        return false;
+    
+    if (!align_file(w->file))
+        return false;
+    rec_entry e;
+    e.offset = ftell(w->file);
+    e.captured = captured - w->first;
+    size_t row = (size_t)frame.cols * frame.channels();
+    for (int y = 0; y < frame.rows; y++)
+        if (fwrite(frame.ptr<uchar>(y), 1, row, w->file) != row)
+            return false;
+    w->index.push_back(e);
+    return true;
+}
+
+bool close_recording_writer(recording_writer *w)
+{
+    rec_header *h = &w->header;
+    bool ok = align_file(w->file);
+    h->magic = RECORDING_MAGIC;
+    h->version = RECORDING_VERSION;
+    h->frames = (uint32_t)w->index.size();
+    h->index_offset = ftell(w->file);
+    ok = ok && (w->index.empty() || fwrite(&w->index[0], sizeof(rec_entry), w->index.size(), w->file) == w->index.size());
+    ok = ok && fseek(w->file, 0, SEEK_SET) == 0 && fwrite(h, sizeof(*h), 1, w->file) == 1;
+    ok = fclose(w->file) == 0 && ok;
+    w->file = NULL;
+    return ok;
+}
+
+// ===================================================================
+// replaying
+// ===================================================================
+
+// MAP_POPULATE reads the whole file in up front, so page faults don't land in the timed
+// run; MAP_PRIVATE + PROT_WRITE lets callers draw on a frame (the overlay is drawn in
+// place) without the drawing reaching the file - the touched pages are copied instead
+bool open_recording(recording *rec, const char *path)
+{
+    rec->data = NULL;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(rec_header)) {
+        close(fd);
+        return false;
+    }
+    void *p = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+        return false;
+    rec->data = (uint8_t *)p;
+    rec->bytes = st.st_size;
+    rec->header = (const rec_header *)p;
+    
+    const rec_header *h = rec->header;
+    size_t frame_bytes = (size_t)h->width * h->height * h->channels;
+    bool ok = h->magic == RECORDING_MAGIC && h->version == RECORDING_VERSION && h->frames > 0 &&
+              h->index_offset + (uint64_t)h->frames * sizeof(rec_entry) <= rec->bytes;
+    rec->index = ok ? (const rec_entry *)(rec->data + h->index_offset) : NULL;
+    for (uint32_t i = 0; ok && i < h->frames; i++)
+        ok = rec->index[i].offset + frame_bytes <= h->index_offset;
+    if (!ok)
+        close_recording(rec);
+    return ok;
+}
+
+Mat recorded_frame(const recording *rec, int i)
+{
+    const rec_header *h = rec->header;
+    return Mat(h->height, h->width, CV_8UC(h->channels), rec->data + rec->index[i].offset);
+}
+
+int recorded_scale(const recording *rec)
+{
+    return max((int)rec->header->scale, 1);
+}
+
+void close_recording(recording *rec)
+{
+    if (rec->data != NULL)
+        munmap(rec->data, rec->bytes);
+    rec->data = NULL;
+}
@@ -0,0 +1,69 @@
+//
+//  recording.h
+//  opencv
+//
+//  raw frame recordings: the frames a source delivered (grayscale, or BGR with -C) with
+//  the times they were captured, so a run can be repeated on exactly the same input,
+//  without the decoder's cost or the camera's timing in the measurements
+//
+//  file layout (host byte order):
+//   rec_header, then the frames (rows packed, width x channels bytes each, every frame
+//   starting at a multiple of RECORDING_ALIGN), then the index: one rec_entry per frame
+//  the header is written last (frames = 0 until then), so an interrupted recording
+//  isn't mistaken for a complete one
+
+#ifndef opencv_recording_h
+#define opencv_recording_h
+
+#include "project.h"
+#include <stdint.h>
+#include <cstdio>
+
+#define RECORDING_MAGIC     0x4345524c      // "LREC"
+#define RECORDING_VERSION   1
+#define RECORDING_EXT       ".lrec"         // file extension open_source() replays
+
+const int RECORDING_ALIGN = 64;             // frame alignment in the file (cache line)
+
+struct rec_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width, height, channels;       // every frame has the same size (1 = gray, 3 = BGR)
+    uint32_t frames;
+    uint64_t index_offset;                  // file offset of the index
+    uint32_t scale;                         // frames are 1/scale of the source's size (-S when recorded;
+                                            //  0 in older recordings = 1)
+    uint8_t reserved[28];                   // (header is 64 bytes)
+};
+
+struct rec_entry {
+    uint64_t offset;                        // file offset of the frame
+    double captured;                        // capture time, s after the first frame
+};
+
+struct recording_writer {
+    FILE *file;
+    rec_header header;
+    vector<rec_entry> index;
+    double first;                           // capture time of the first frame (now())
+};
+
+// a recording mapped into memory
+struct recording {
+    uint8_t *data;                          // the whole file (NULL if none is open)
+    size_t bytes;
+    const rec_header *header;
+    const rec_entry *index;
+};
+
+bool open_recording_writer(recording_writer *, const char *, int);    // file, scale the frames were decoded at
+bool write_frame(recording_writer *, const Mat &, double);     // frame, capture time (now()); false if
+                                                                //  its size/type differs from the first
+bool close_recording_writer(recording_writer *);                // writes index + header; false on error
+
+bool open_recording(recording *, const char *);     // maps the file; false if it isn't a complete recording
+Mat recorded_frame(const recording *, int);         // frame i, pointing into the mapping (no copy)
+int recorded_scale(const recording *);              // 1/scale the frames were decoded at (1, 2, 4 or 8)
+void close_recording(recording *);
+
+#endif
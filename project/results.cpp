@@ -0,0 +1,200 @@
+//
+//  results.cpp
+//  opencv
+//
+
+#include "results.h"
+
+bool open_results(result_writer *w, const char *path, int format)
+{
+    w->format = format;
+    w->start = now();
+    if (strcmp(path, "-") == 0)
+        w->out = stdout;
+    else
+        w->out = fopen(path, format == RESULTS_BINARY ? "wb" : "w");
+    if (w->out == NULL) {
+        cout << "cannot write results to " << path << endl;
+        return false;
+    }
+    return true;
+}
+
+void close_results(result_writer *w)
+{
+    if (w->out == NULL)
+        return;
+    if (w->out == stdout)
+        fflush(stdout);
+    else
+        fclose(w->out);
+    w->out = NULL;
+}
+
+// picks from the lane index: leftmost and rightmost line, and the middle line (between
+// the oncoming lanes and the car's lane) if there are lanes left of the car's
+static uint8_t select_lines(const lane_index *index, Vec4i selected[3])
+{
+    if (index->lines.empty())
+        return 0;
+    selected[0] = index->lines.front();
+    selected[2] = index->lines.back();
+    if (index->own_lane > 0) {
+        selected[1] = index->lines[index->own_lane];
+        return SELECTED_LEFT | SELECTED_MIDDLE | SELECTED_RIGHT;
+    }
+    return SELECTED_LEFT | SELECTED_RIGHT;
+}
+
+// ------------------------
+// NDJSON
+
+// appends "name":[[x1,y1,x2,y2],...] to the buffer, returns the new length
+static int json_lines(char *buf, int len, const char *name, const vector<Vec4i> &lines)
+{
+    int n = min((int)lines.size(), MAX_RESULT_LINES);
+    if (len >= RESULT_BUF_SIZE)
+        return len;
+    len += snprintf(buf + len, RESULT_BUF_SIZE - len, ",\"%s\":[", name);
+    for (int i = 0; i < n && len < RESULT_BUF_SIZE; i++) {
+        const Vec4i &l = lines[i];
+        len += snprintf(buf + len, RESULT_BUF_SIZE - len, "%s[%d,%d,%d,%d]",
+                        i ? "," : "", l[X1], l[Y1], l[X2], l[Y2]);
+    }
+    if (len < RESULT_BUF_SIZE)
+        len += snprintf(buf + len, RESULT_BUF_SIZE - len, "]");
+    return len;
+}
+
+static int json_line(char *buf, int len, const char *name, bool present, const Vec4i &l)
+{
+    if (len >= RESULT_BUF_SIZE)
+        return len;
+    if (!present)
+        return len + snprintf(buf + len, RESULT_BUF_SIZE - len, ",\"%s\":null", name);
+    return len + snprintf(buf + len, RESULT_BUF_SIZE - len, ",\"%s\":[%d,%d,%d,%d]",
+                          name, l[X1], l[Y1], l[X2], l[Y2]);
+}
+
+// appends "name":[[[x,y],...],...] (one polyline per line) to the buffer, returns the new length
+static int json_paths(char *buf, int len, const char *name, const lane_index *index)
+{
+    int n = min((int)index->lines.size(), MAX_RESULT_LINES);
+    int points = n ? (int)(index->paths.size() / index->lines.size()) : 0;
+    if (len >= RESULT_BUF_SIZE)
+        return len;
+    len += snprintf(buf + len, RESULT_BUF_SIZE - len, ",\"%s\":[", name);
+    for (int i = 0; i < n && len < RESULT_BUF_SIZE; i++) {
+        const Point *p = &index->paths[i * points];
+        len += snprintf(buf + len, RESULT_BUF_SIZE - len, "%s[", i ? "," : "");
+        for (int k = 0; k < points && len < RESULT_BUF_SIZE; k++)
+            len += snprintf(buf + len, RESULT_BUF_SIZE - len, "%s[%d,%d]", k ? "," : "", p[k].x, p[k].y);
+        if (len < RESULT_BUF_SIZE)
+            len += snprintf(buf + len, RESULT_BUF_SIZE - len, "]");
+    }
+    if (len < RESULT_BUF_SIZE)
+        len += snprintf(buf + len, RESULT_BUF_SIZE - len, "]");
+    return len;
+}
+
+// appends the stage times (ms) and the telemetry readings that are known
+static int json_telemetry(char *buf, int len, const detector *det, const telemetry_sample *t)
+{
+    if (len >= RESULT_BUF_SIZE)
+        return len;
+    len += snprintf(buf + len, RESULT_BUF_SIZE - len, ",\"stages\":{\"edges\":%.3f,\"segments\":%.3f,\"model\":%.3f}",
+                    1000 * det->edge_time, 1000 * det->segment_time, 1000 * det->model_time);
+    if (t->mhz >= 0 && len < RESULT_BUF_SIZE)
+        len += snprintf(buf + len, RESULT_BUF_SIZE - len, ",\"mhz\":%.0f", t->mhz);
+    if (t->temp >= 0 && len < RESULT_BUF_SIZE)
+        len += snprintf(buf + len, RESULT_BUF_SIZE - len, ",\"temp_c\":%.1f", t->temp);
+    if (t->throttled >= 0 && len < RESULT_BUF_SIZE)
+        len += snprintf(buf + len, RESULT_BUF_SIZE - len, ",\"throttled\":%s", t->throttled ? "true" : "false");
+    if (t->joules >= 0 && len < RESULT_BUF_SIZE)
+        len += snprintf(buf + len, RESULT_BUF_SIZE - len, ",\"joules\":%.4f", t->joules);
+    return len;
+}
+
+// the whole record without its "}\n"; without lists, the segments, combined, lanes and
+// paths are left out (for a record that doesn't fit) and "truncated":true is added
+static int json_record(char *buf, int frame, double timestamp, const detector *det, uint8_t which,
+                       const Vec4i selected[3], const telemetry_sample *telemetry, bool lists)
+{
+    int len = snprintf(buf, RESULT_BUF_SIZE, "{\"frame\":%d,\"t\":%.6f,\"width\":%d,\"height\":%d",
+                       frame, timestamp, det->size.width, det->size.height);
+    if (lists) {
+        len = json_lines(buf, len, "segments", det->segments);
+        len = json_lines(buf, len, "combined", det->combined);
+        len = json_lines(buf, len, "lanes", det->index.lines);
+        if (!det->index.paths.empty())
+            len = json_paths(buf, len, "paths", &det->index);
+    }
+    else
+        len += snprintf(buf + len, RESULT_BUF_SIZE - len, ",\"truncated\":true");
+    len = json_line(buf, len, "left", which & SELECTED_LEFT, selected[0]);
+    len = json_line(buf, len, "middle", which & SELECTED_MIDDLE, selected[1]);
+    len = json_line(buf, len, "right", which & SELECTED_RIGHT, selected[2]);
+    if (len < RESULT_BUF_SIZE)
+        len += snprintf(buf + len, RESULT_BUF_SIZE - len, ",\"own_lane\":%d", det->index.own_lane);
+    if (det->coverage >= 0 && len < RESULT_BUF_SIZE)
+        len += snprintf(buf + len, RESULT_BUF_SIZE - len, ",\"coverage\":%.3f", det->coverage);
+    if (telemetry != NULL)
+        len = json_telemetry(buf, len, det, telemetry);
+    return len;
+}
+
+// ------------------------
+// binary
+
+static int binary_lines(char *buf, int len, const vector<Vec4i> &lines, int n)
+{
+    int16_t *p = (int16_t *)(buf + len);
+    for (int i = 0; i < n; i++)
+        for (int k = 0; k < 4; k++)
+            *p++ = (int16_t)lines[i][k];
+    return len + n * 4 * sizeof(int16_t);
+}
+
+// ------------------------
+
+void write_result(result_writer *w, int frame, const detector *det, const telemetry_sample *telemetry)
+{
+    Vec4i selected[3];
+    uint8_t which = select_lines(&det->index, selected);
+    double timestamp = now() - w->start;
+    char *buf = w->buf;
+    int len;
+    
+    if (w->format == RESULTS_NDJSON) {
+        len = json_record(buf, frame, timestamp, det, which, selected, telemetry, true);
+        if (len >= RESULT_BUF_SIZE - 2)     // (the rest is small: it always fits)
+            len = json_record(buf, frame, timestamp, det, which, selected, telemetry, false);
+        len += sprintf(buf + len, "}\n");
+    }
+    else {
+        result_header *h = (result_header *)buf;
+        h->magic = RESULT_MAGIC;
+        h->frame = frame;
+        h->timestamp = timestamp;
+        h->width = det->size.width;
+        h->height = det->size.height;
+        h->num_segments = min((int)det->segments.size(), MAX_RESULT_LINES);
+        h->num_combined = min((int)det->combined.size(), MAX_RESULT_LINES);
+        h->num_lanes = min((int)det->index.lines.size(), MAX_RESULT_LINES);
+        h->selected = which;
+        h->own_lane = det->index.own_lane < 0 ? NO_LANE : det->index.own_lane;
+        h->reserved = 0;
+        len = sizeof(result_header);
+        len = binary_lines(buf, len, det->segments, h->num_segments);
+        len = binary_lines(buf, len, det->combined, h->num_combined);
+        len = binary_lines(buf, len, det->index.lines, h->num_lanes);
+        // selected lines are always present in the record (zeros when absent)
+        for (int i = 0; i < 3; i++) {
+            int16_t *p = (int16_t *)(buf + len);
+            for (int k = 0; k < 4; k++)
+                p[k] = (which & (1 << i)) ? (int16_t)selected[i][k] : 0;
+            len += 4 * sizeof(int16_t);
+        }
+    }
+    fwrite(buf, 1, len, w->out);
+}
@@ -0,0 +1,65 @@
+//
+//  results.h
+//  opencv
+//
+//  per-frame lane results as a data stream (instead of, or next to, the output image):
+//  the filtered segments, combine_lines and extend_lines output (lanes: left to right),
+//  the selected left/middle/right lines and the car's lane, as one NDJSON line or one
+//  binary record per frame; models that fit curves add each lane's polyline ("paths",
+//  NDJSON only: binary records keep their fixed layout and carry the chords); with
+//  telemetry (-i) an NDJSON record also has the frame's stage times and the machine's
+//  state after it (telemetry.h), the readings a machine lacks left out
+//
+//  records are built in a buffer owned by the writer, so writing a frame doesn't allocate;
+//  an NDJSON record that doesn't fit is written without its lists, with "truncated":true
+
+#ifndef opencv_results_h
+#define opencv_results_h
+
+#include "engine.h"
+#include "telemetry.h"
+#include <stdint.h>
+#include <cstdio>
+
+enum { RESULTS_NDJSON, RESULTS_BINARY };
+
+const int MAX_RESULT_LINES = 256;           // lines written per list (more are dropped)
+const int RESULT_BUF_SIZE = 64 * 1024;      // big enough for 3 full lists of NDJSON (a record with
+                                            //  more, e.g. long paths, is written without its lists)
+
+// binary record (little-endian, host layout):
+//  result_header, then num_segments + num_combined + num_lanes lines of
+//  4 x int16 (x1,y1,x2,y2), then the 3 selected lines (left, middle, right),
+//  whose presence is given by the SELECTED_* bits of selected
+#define RESULT_MAGIC    0x3152414c          // "LAR1"
+
+const uint8_t SELECTED_LEFT = 1;
+const uint8_t SELECTED_MIDDLE = 2;
+const uint8_t SELECTED_RIGHT = 4;
+const uint8_t NO_LANE = 0xff;               // own_lane when no lane was found
+
+struct result_header {
+    uint32_t magic;
+    uint32_t frame;
+    double timestamp;                       // s since the stream was opened
+    uint16_t width, height;
+    uint16_t num_segments, num_combined, num_lanes;
+    uint8_t selected;
+    uint8_t own_lane;                       // lane the car is in (between lane lines i and i+1)
+    uint32_t reserved;                      // 0 (the header is 32 bytes, no padding)
+};
+static_assert(sizeof(result_header) == 32, "result_header must have no padding");
+
+struct result_writer {
+    FILE *out;
+    int format;
+    double start;
+    char buf[RESULT_BUF_SIZE];
+};
+
+bool open_results(result_writer *, const char *, int);     // "-" = stdout
+void write_result(result_writer *, int, const detector *, const telemetry_sample *);    // one record for a
+                                                                                        //  frame (telemetry: NULL if off)
+void close_results(result_writer *);
+
+#endif
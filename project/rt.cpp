@@ -0,0 +1,130 @@
+//
+//  rt.cpp
+//  opencv
+//
+
+#include "rt.h"
+#include <sys/mman.h>
+#include <pthread.h>
+#include <cstring>
+#include <cerrno>
+
+// each kind of failure is only reported once, not once per thread
+static bool warned_pin = false, warned_sched = false, warned_lock = false;
+
+void init_rt_config(rt_config *rt)
+{
+    rt->cpus.clear();
+    rt->policy = SCHED_OTHER;
+    rt->priority = 0;
+    rt->lock_memory = false;
+}
+
+bool parse_cpu_list(const char *list, vector<int> *cpus)
+{
+    cpus->clear();
+    const char *p = list;
+    while (*p) {
+        char *end;
+        long first = strtol(p, &end, 10);
+        if (end == p || first < 0)
+            return false;
+        long last = first;
+        if (*end == '-') {
+            p = end + 1;
+            last = strtol(p, &end, 10);
+            if (end == p || last < first)
+                return false;
+        }
+        for (long c = first; c <= last; c++)
+            cpus->push_back((int)c);
+        if (*end == ',')
+            end++;
+        else if (*end != '\0')
+            return false;
+        p = end;
+    }
+    return !cpus->empty();
+}
+
+bool parse_sched(const char *spec, rt_config *rt)
+{
+    string s = spec;
+    size_t colon = s.find(':');
+    string name = s.substr(0, colon);
+    int priority = colon == string::npos ? 1 : atoi(s.c_str() + colon + 1);
+    
+    if (name == "other") {
+        rt->policy = SCHED_OTHER;
+        rt->priority = 0;
+        return true;
+    }
+    if (name == "fifo")
+        rt->policy = SCHED_FIFO;
+    else if (name == "rr")
+        rt->policy = SCHED_RR;
+    else
+        return false;
+    rt->priority = max(sched_get_priority_min(rt->policy), min(priority, sched_get_priority_max(rt->policy)));
+    return true;
+}
+
+bool rt_enabled(const rt_config *rt)
+{
+    return !rt->cpus.empty() || rt->policy != SCHED_OTHER || rt->lock_memory;
+}
+
+// ===================================================================
+// applying settings
+// ===================================================================
+
+void apply_process_rt(const rt_config *rt)
+{
+    if (rt->lock_memory && mlockall(MCL_CURRENT | MCL_FUTURE) != 0 && !warned_lock) {
+        cout << "warning: cannot lock memory (" << strerror(errno)
+             << "), check ulimit -l; continuing unlocked" << endl;
+        warned_lock = true;
+    }
+}
+
+// pins the calling thread to cpus[index % n] and sets its scheduling policy
+void apply_thread_rt(const rt_config *rt, int index)
+{
+    if (!rt->cpus.empty()) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(rt->cpus[index % rt->cpus.size()], &set);
+        int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (err != 0 && !warned_pin) {
+            cout << "warning: cannot pin thread to cpu " << rt->cpus[index % rt->cpus.size()]
+                 << " (" << strerror(err) << "); continuing unpinned" << endl;
+            warned_pin = true;
+        }
+    }
+    
+    if (rt->policy != SCHED_OTHER) {
+        sched_param param;
+        param.sched_priority = rt->priority;
+        int err = pthread_setschedparam(pthread_self(), rt->policy, &param);
+        if (err != 0 && !warned_sched) {
+            cout << "warning: cannot set real-time scheduling (" << strerror(err)
+                 << "), needs root or CAP_SYS_NICE; continuing with SCHED_OTHER" << endl;
+            warned_sched = true;
+        }
+    }
+}
+
+void reset_thread_rt()
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    int n = getNumberOfCPUs();
+    for (int c = 0; c < n && c < CPU_SETSIZE; c++)
+        CPU_SET(c, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    
+    sched_param param;
+    param.sched_priority = 0;
+    pthread_setschedparam(pthread_self(), SCHED_OTHER, &param);
+    munlockall();
+}
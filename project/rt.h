@@ -0,0 +1,34 @@
+//
+//  rt.h
+//  opencv
+//
+//  latency tuning for the pipeline threads: pinning to cores, real-time
+//  scheduling (SCHED_FIFO/SCHED_RR) and locking memory
+//
+//  every setting needs privileges that aren't always there (CAP_SYS_NICE,
+//  RLIMIT_MEMLOCK, cpuset limits); if one fails a warning is printed once and
+//  the thread keeps running with the default setting
+
+#ifndef opencv_rt_h
+#define opencv_rt_h
+
+#include "project.h"
+#include <sched.h>
+
+struct rt_config {
+    vector<int> cpus;                       // cores to pin to (thread i gets cpus[i % size]), empty = any
+    int policy;                             // SCHED_OTHER (default), SCHED_FIFO or SCHED_RR
+    int priority;                           // 1-99, for SCHED_FIFO/SCHED_RR
+    bool lock_memory;                       // mlockall() so no page of the process is ever swapped/faulted out
+};
+
+void init_rt_config(rt_config *);
+bool parse_cpu_list(const char *, vector<int> *);   // "2,3" or "1-3" or "0,2-3"
+bool parse_sched(const char *, rt_config *);        // "fifo:50", "rr:20" or "other"
+bool rt_enabled(const rt_config *);                 // true if any setting differs from the default
+
+void apply_process_rt(const rt_config *);   // process-wide settings (memory locking)
+void apply_thread_rt(const rt_config *, int);   // pins/schedules the calling thread as thread i
+void reset_thread_rt();                     // calling thread back to SCHED_OTHER on any core, memory unlocked
+
+#endif
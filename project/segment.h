@@ -0,0 +1,112 @@
+//
+//  segment.h
+//  opencv
+//
+//  compact line segments and templated geometry:
+//  seg16 holds a line in four int16_t (8 bytes, half a Vec4i; frames never exceed
+//  32767 px), and the geometry routines below work on either type. same_line takes
+//  its tolerances as template arguments and compares slopes and intercepts with
+//  exact integer cross-multiplication instead of doubles, so the tolerances fold
+//  into constants and a row of pairwise tests has no divisions or branches on NaN/inf
+
+#ifndef opencv_segment_h
+#define opencv_segment_h
+
+#include "project.h"
+#include <stdint.h>
+
+// project.h's tolerances as integers, for template arguments (a const double can't be one),
+// derived from the macros so a PARAMS override changes both paths alike
+//  the paths only disagree on exact ties (e.g. a slope ratio of exactly 1.7), which the
+//  doubles round either way; benchmark_geometry() counts them
+const int SLOPE_TOL_MILLI = (int)(SLOPE_TOLERANCE * 1000 + 0.5);   // SLOPE_TOLERANCE, in 1/1000
+const int POINT_TOL_PX = (int)(POINT_TOLERANCE + 0.5);              // POINT_TOLERANCE, rounded to px
+
+struct seg16 {
+    int16_t v[4];                           // x1, y1, x2, y2
+    int16_t operator[](int i) const { return v[i]; }
+    int16_t &operator[](int i) { return v[i]; }
+};
+
+inline seg16 to_seg16(Vec4i l)
+{
+    seg16 s = { { (int16_t)l[X1], (int16_t)l[Y1], (int16_t)l[X2], (int16_t)l[Y2] } };
+    return s;
+}
+
+inline Vec4i to_vec4i(seg16 s)
+{
+    return Vec4i(s[X1], s[Y1], s[X2], s[Y2]);
+}
+
+// ---
+// double geometry, for any line type (same formulas as project.cpp)
+// ---
+template <typename L> inline double slope(const L &l)
+{
+    return (double)(l[Y2]-l[Y1]) / (double)(l[X2]-l[X1]);
+}
+
+template <typename L> inline double y_intercept(const L &l)
+{
+    return l[Y2] - slope(l)*l[X2];
+}
+
+template <typename L> inline double x_intercept(const L &l)
+{
+    return l[X2] - (double)l[Y2]/slope(l);
+}
+
+// ---
+// fixed-point geometry
+// ---
+
+// |x-intercept| as a fraction num/den (den > 0): x2 - y2*dx/dy = (x2*dy - y2*dx) / dy
+//  the same for either endpoint order, so lines needn't be normalised first
+template <typename L> inline void x_intercept_parts(const L &l, int64_t *num, int64_t *den)
+{
+    int64_t dx = l[X2] - l[X1], dy = l[Y2] - l[Y1];
+    int64_t n = (int64_t)l[X2]*dy - (int64_t)l[Y2]*dx;
+    *num = n < 0 ? -n : n;
+    *den = dy < 0 ? -dy : dy;
+}
+
+// same_line() of project.cpp, exactly (no rounding):
+//  |slope2| strictly within |slope1| * (1 -+ SLOPE_TOL/1000), compared as |dy2|*|dx1| against |dy1|*|dx2|
+//  (the double version's three sign cases all reduce to this; vertical/horizontal lines never match)
+//  | |x-intercept2| - |x-intercept1| | < POINT_TOL, compared as num2*den1 - num1*den2 against POINT_TOL*den1*den2
+template <int SLOPE_TOL, int POINT_TOL, typename L> inline bool same_line(const L &l1, const L &l2)
+{
+    int64_t dx1 = abs(l1[X2] - l1[X1]), dy1 = abs(l1[Y2] - l1[Y1]);
+    int64_t dx2 = abs(l2[X2] - l2[X1]), dy2 = abs(l2[Y2] - l2[Y1]);
+    int64_t s2 = 1000 * dy2 * dx1;          // |slope2| * 1000 * dx1*dx2
+    int64_t s1 = dy1 * dx2;                 // |slope1| * dx1*dx2
+    if (dx1 == 0 || dx2 == 0 || !(s2 > (1000 - SLOPE_TOL) * s1 && s2 < (1000 + SLOPE_TOL) * s1))
+        return false;
+    
+    int64_t n1, d1, n2, d2;
+    x_intercept_parts(l1, &n1, &d1);
+    x_intercept_parts(l2, &n2, &d2);
+    int64_t diff = n2*d1 - n1*d2;
+    return (diff < 0 ? -diff : diff) < POINT_TOL * d1 * d2;
+}
+
+// same_line with project.h's tolerances
+template <typename L> inline bool same_line_fixed(const L &l1, const L &l2)
+{
+    return same_line<SLOPE_TOL_MILLI, POINT_TOL_PX>(l1, l2);
+}
+
+// adjacent()/seperated() of project.cpp for any line type (integer already)
+//  both assume l1, l2 are the "same" line and l1 is higher up than l2
+template <typename L> inline bool adjacent(const L &l1, const L &l2)
+{
+    return max(l1[Y1], l1[Y2]) >= min(l2[Y1], l2[Y2]);
+}
+
+template <typename L> inline bool seperated(const L &l1, const L &l2)
+{
+    return max(l1[Y1], l1[Y2]) <= min(l2[Y1], l2[Y2]);
+}
+
+#endif
@@ -0,0 +1,481 @@
+//
+//  source.cpp
+//  opencv
+//
+
+#include "source.h"
+#include "cache.h"
+#include <cerrno>
+#include <time.h>
+
+#ifdef HAVE_LIBJPEG
+#include <csetjmp>
+#include <jpeglib.h>
+#endif
+
+// extensions imread() is used for; anything else is opened as a video
+const char *IMAGE_EXTENSIONS[] = { ".png", ".jpg", ".jpeg", ".bmp", ".pgm", ".ppm", ".tif", ".tiff" };
+
+// lower-case extension of a file name, with the dot ("" if none)
+static string extension(const string &name)
+{
+    size_t dot = name.rfind('.');
+    if (dot == string::npos)
+        return "";
+    string ext = name.substr(dot);
+    for (size_t i = 0; i < ext.size(); i++)
+        ext[i] = tolower(ext[i]);
+    return ext;
+}
+
+bool is_image_file(const string &name)
+{
+    string ext = extension(name);
+    for (size_t i = 0; i < sizeof(IMAGE_EXTENSIONS) / sizeof(IMAGE_EXTENSIONS[0]); i++)
+        if (ext == IMAGE_EXTENSIONS[i])
+            return true;
+    return false;
+}
+
+// opens a camera ("cam:0"), a recording, a video file, or a single still image
+//  returns false if a camera/video/recording can't be opened (images fail on first read)
+bool open_source(frame_source *src, const string &spec)
+{
+    src->name = spec;
+    src->files.clear();
+    src->next = 0;
+    src->video = false;
+    src->scale = 1;
+    src->roi_only = false;
+    src->colour = false;
+    src->decode_time = 0;
+    src->prefetch = NULL;
+    src->io_wait = 0;
+    src->captured = 0;
+    src->replay.data = NULL;
+    src->realtime = false;
+    
+    if (spec.compare(0, strlen(CAMERA_PREFIX), CAMERA_PREFIX) == 0) {
+        src->video = true;
+        return src->cap.open(atoi(spec.c_str() + strlen(CAMERA_PREFIX)));
+    }
+    if (extension(spec) == RECORDING_EXT)
+        return open_recording(&src->replay, spec.c_str());
+    if (!is_image_file(spec)) {
+        src->video = true;
+        return src->cap.open(spec);
+    }
+    src->files.push_back(spec);
+    return true;
+}
+
+void open_image_list(frame_source *src, const vector<string> &files)
+{
+    src->name = files.size() == 1 ? files[0] : files[0] + " ...";
+    src->files = files;
+    src->next = 0;
+    src->video = false;
+    src->scale = 1;
+    src->roi_only = false;
+    src->colour = false;
+    src->decode_time = 0;
+    src->prefetch = NULL;
+    src->io_wait = 0;
+    src->captured = 0;
+    src->replay.data = NULL;
+    src->realtime = false;
+}
+
+// luma of a BGR frame into a buffer that is reused from frame to frame (same size: no
+// allocation); cvtColor's BGR2GRAY is a single vectorized pass
+void to_luma(const Mat &bgr, Mat &gray)
+{
+    if (bgr.channels() == 1)
+        bgr.copyTo(gray);
+    else
+        cvtColor(bgr, gray, COLOR_BGR2GRAY);
+}
+
+void close_source(frame_source *src)
+{
+    close_recording(&src->replay);
+}
+
+// next frame of a recording: no decoding, the frame points into the mapped file (a gray
+// one is handed out as it is); with realtime set, waits until the frame's recorded time
+//  after the first one
+static bool next_recorded(frame_source *src, Mat &gray)
+{
+    const rec_header *h = src->replay.header;
+    if (src->next >= h->frames)
+        return false;
+    int i = (int)src->next++;
+    if (src->realtime && i > 0) {
+        double due = src->replay_start + src->replay.index[i].captured;
+        timespec ts;
+        ts.tv_sec = (time_t)due;
+        ts.tv_nsec = (long)((due - ts.tv_sec) * 1e9);
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+            ;
+    }
+    src->captured = now();
+    if (i == 0)
+        src->replay_start = src->captured;
+    
+    double start = now();
+    TRACE_BEGIN("decode");
+    Mat frame = recorded_frame(&src->replay, i);
+    if (h->channels == 1)
+        gray = frame;
+    else
+        to_luma(frame, gray);
+    if (src->colour && h->channels == 1)
+        cvtColor(frame, src->frame, COLOR_GRAY2BGR);
+    else if (src->colour)
+        src->frame = frame;
+    // no shrinking: the frames were recorded at the recording's scale (main takes that over)
+    TRACE_END("decode");
+    src->decode_time += now() - start;
+    return true;
+}
+
+static Mat decode(const string &, const Mat &, int, bool, bool);
+
+// reads the next frame as grayscale (and with colour set, keeps the colour frame in frame)
+//  returns false at the end of the source (or if an image can't be read)
+bool next_frame(frame_source *src, Mat &gray)
+{
+    if (src->replay.data != NULL)
+        return next_recorded(src, gray);
+    
+    double start = now();
+    if (src->video) {
+        TRACE_BEGIN("decode");
+        // grab() returns once the camera has delivered the frame, retrieve() decodes it
+        bool ok = src->cap.grab();
+        src->captured = now();
+        ok = ok && src->cap.retrieve(src->frame) && !src->frame.empty();
+        // video decoders can't decode at reduced size, so shrink afterwards
+        // (the colour frame if it's kept, else just the gray one)
+        if (ok && src->colour && src->scale > 1)
+            resize(src->frame, src->frame, Size(src->frame.cols / src->scale, src->frame.rows / src->scale),
+                   0, 0, INTER_AREA);
+        if (ok && src->frame.channels() == 1)
+            gray = src->frame;
+        else if (ok)
+            to_luma(src->frame, gray);
+        if (ok && !src->colour && src->scale > 1)
+            resize(gray, gray, Size(gray.cols / src->scale, gray.rows / src->scale), 0, 0, INTER_AREA);
+        TRACE_END("decode");
+        src->decode_time += now() - start;
+        return ok;
+    }
+    
+    if (src->next >= src->files.size())
+        return false;
+    size_t i = src->next++;
+    const string &file = src->files[i];
+    src->captured = start;
+    // a file the read-ahead couldn't read (bytes left empty) is read directly below
+    Mat bytes;
+    double waited = 0;
+    if (src->prefetch != NULL) {
+        TRACE_BEGIN("read");
+        waited = src->prefetch->wait_time;
+        take_file(src->prefetch, i, bytes);
+        waited = src->prefetch->wait_time - waited;
+        src->io_wait += waited;
+        TRACE_END("read");
+    }
+    TRACE_BEGIN("decode");
+    if (src->colour) {
+        src->frame = decode(file, bytes, src->scale, src->roi_only, true);
+        if (!src->frame.empty())
+            to_luma(src->frame, gray);
+    }
+    else
+        gray = decode(file, bytes, src->scale, src->roi_only, false);
+    TRACE_END("decode");
+    if (src->prefetch != NULL)
+        release_file(src->prefetch, i);
+    src->decode_time += now() - start - waited;
+    if ((src->colour ? src->frame : gray).empty()) {
+        cout << "cannot open " << file << endl;
+        return false;
+    }
+    return true;
+}
+
+// ===================================================================
+// reduced decoding
+// ===================================================================
+
+#ifdef HAVE_LIBJPEG
+// libjpeg calls exit() on errors by default; jump back and fail the decode instead
+struct jpeg_fail_mgr {
+    jpeg_error_mgr mgr;
+    jmp_buf jump;
+};
+
+static void jpeg_fail(j_common_ptr cinfo)
+{
+    longjmp(((jpeg_fail_mgr *)cinfo->err)->jump, 1);
+}
+
+// decodes a JPEG to grayscale at 1/scale size (DCT scaling), skipping the rows above
+// DECODE_ROI_TOP (left black, so the frame keeps its size and coordinates)
+//  from the file's bytes if it was read already, else from the file
+//  needs libjpeg-turbo >= 1.5 for jpeg_skip_scanlines()
+static Mat decode_jpeg_roi(const string &file, const Mat &bytes, int scale)
+{
+    FILE *f = bytes.empty() ? fopen(file.c_str(), "rb") : NULL;
+    if (f == NULL && bytes.empty())
+        return Mat();
+    
+    jpeg_decompress_struct cinfo;
+    jpeg_fail_mgr err;
+    Mat img;
+    cinfo.err = jpeg_std_error(&err.mgr);
+    err.mgr.error_exit = jpeg_fail;
+    if (setjmp(err.jump)) {
+        jpeg_destroy_decompress(&cinfo);
+        if (f != NULL)
+            fclose(f);
+        return Mat();
+    }
+    jpeg_create_decompress(&cinfo);
+    if (f != NULL)
+        jpeg_stdio_src(&cinfo, f);
+    else
+        jpeg_mem_src(&cinfo, bytes.data, bytes.total());
+    jpeg_read_header(&cinfo, TRUE);
+    cinfo.out_color_space = JCS_GRAYSCALE;
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = scale;
+    jpeg_start_decompress(&cinfo);
+    
+    img = Mat::zeros(cinfo.output_height, cinfo.output_width, CV_8UC1);
+    jpeg_skip_scanlines(&cinfo, (JDIMENSION)(cinfo.output_height * DECODE_ROI_TOP));
+    while (cinfo.output_scanline < cinfo.output_height) {
+        JSAMPROW row = img.ptr<uchar>(cinfo.output_scanline);
+        jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    if (f != NULL)
+        fclose(f);
+    return img;
+}
+#endif
+
+// imread()/imdecode() flags for a grayscale or BGR image at 1/scale of its size
+static int read_flags(int scale, bool colour)
+{
+    if (colour) {
+        switch (scale) {
+            case 2:  return IMREAD_REDUCED_COLOR_2;
+            case 4:  return IMREAD_REDUCED_COLOR_4;
+            case 8:  return IMREAD_REDUCED_COLOR_8;
+            default: return IMREAD_COLOR;
+        }
+    }
+    switch (scale) {
+        case 2:  return IMREAD_REDUCED_GRAYSCALE_2;
+        case 4:  return IMREAD_REDUCED_GRAYSCALE_4;
+        case 8:  return IMREAD_REDUCED_GRAYSCALE_8;
+        default: return IMREAD_GRAYSCALE;
+    }
+}
+
+// reads an image as grayscale (or BGR) at 1/scale of its size (scale = 1, 2, 4 or 8),
+// from the file's bytes if they were read already (prefetch.h), else from the file
+//  JPEGs are scaled during decoding by OpenCV (IMREAD_REDUCED_*), other formats are
+//  decoded full size and then shrunk; roi_only skips the sky rows of JPEGs (libjpeg,
+//  grayscale only)
+static Mat read_image(const string &file, const Mat &bytes, int scale, bool roi_only, bool colour)
+{
+#ifdef HAVE_LIBJPEG
+    string ext = extension(file);
+    if (roi_only && !colour && (ext == ".jpg" || ext == ".jpeg"))
+        return decode_jpeg_roi(file, bytes, scale);
+#endif
+    if (!bytes.empty())
+        return imdecode(bytes, read_flags(scale, colour));
+    return imread(file, read_flags(scale, colour));
+}
+
+// read_image(), or the decoded image from the stage cache if the file's contents were
+// decoded the same way before (bytes or file hash the same)
+static Mat decode(const string &file, const Mat &bytes, int scale, bool roi_only, bool colour)
+{
+    cache_key key = 0;
+    if (stage_cache_enabled())
+        key = bytes.empty() ? hash_file(file) : hash_bytes(bytes.data, bytes.total(), CACHE_SEED);
+    if (key != 0) {
+        double params[3] = { (double)scale, (double)roi_only, (double)colour };
+        key = hash_params("decode", params, 3, key);
+        Mat img;
+        if (cache_get(key, img))
+            return img;
+    }
+    Mat img = read_image(file, bytes, scale, roi_only, colour);
+    if (key != 0 && !img.empty())
+        cache_put(key, img);
+    return img;
+}
+
+Mat decode_image(const string &file, int scale, bool roi_only, bool colour)
+{
+    return decode(file, Mat(), scale, roi_only, colour);
+}
+
+// ===================================================================
+// band sources - images read a few rows at a time
+// ===================================================================
+
+#ifdef HAVE_LIBJPEG
+struct jpeg_rows {
+    FILE *f;
+    jpeg_decompress_struct cinfo;
+    jpeg_fail_mgr err;
+};
+
+// starts decoding a JPEG to grayscale, one scanline at a time
+static bool open_jpeg_rows(band_source *src, const string &file)
+{
+    FILE *f = fopen(file.c_str(), "rb");
+    if (f == NULL)
+        return false;
+    jpeg_rows *j = new jpeg_rows;
+    j->f = f;
+    j->cinfo.err = jpeg_std_error(&j->err.mgr);
+    j->err.mgr.error_exit = jpeg_fail;
+    if (setjmp(j->err.jump)) {
+        jpeg_destroy_decompress(&j->cinfo);
+        fclose(f);
+        delete j;
+        return false;
+    }
+    jpeg_create_decompress(&j->cinfo);
+    jpeg_stdio_src(&j->cinfo, f);
+    jpeg_read_header(&j->cinfo, TRUE);
+    j->cinfo.out_color_space = JCS_GRAYSCALE;
+    jpeg_start_decompress(&j->cinfo);
+    src->jpeg = j;
+    src->size = Size(j->cinfo.output_width, j->cinfo.output_height);
+    return true;
+}
+
+static bool read_jpeg_row(jpeg_rows *j, uchar *row)
+{
+    if (setjmp(j->err.jump))
+        return false;
+    JSAMPROW rows[1] = { row };
+    return jpeg_read_scanlines(&j->cinfo, rows, 1) == 1;
+}
+#endif
+
+// reads the header of a binary (P5) 8-bit PGM, leaving the file at the first row
+static bool open_pgm(band_source *src, const string &file)
+{
+    FILE *f = fopen(file.c_str(), "rb");
+    if (f == NULL)
+        return false;
+    int values[3];                          // width, height, maxval
+    bool ok = fgetc(f) == 'P' && fgetc(f) == '5';
+    for (int i = 0; ok && i < 3; i++) {
+        int c = fgetc(f);
+        while (isspace(c) || c == '#') {    // comments run to the end of the line
+            if (c == '#')
+                while (c != '\n' && c != EOF)
+                    c = fgetc(f);
+            c = fgetc(f);
+        }
+        ungetc(c, f);
+        ok = fscanf(f, "%d", &values[i]) == 1;
+    }
+    // a single whitespace character separates the header from the pixels
+    if (!ok || !isspace(fgetc(f)) || values[0] <= 0 || values[1] <= 0 || values[2] > 255) {
+        fclose(f);
+        return false;
+    }
+    src->pgm = f;
+    src->size = Size(values[0], values[1]);
+    return true;
+}
+
+bool open_band_source(band_source *src, const string &file)
+{
+    src->name = file;
+    src->next_row = 0;
+    src->pgm = NULL;
+    src->jpeg = NULL;
+    src->synthetic = false;
+    src->whole.release();
+    
+    string ext = extension(file);
+    if (ext == ".pgm" && open_pgm(src, file))
+        return true;
+#ifdef HAVE_LIBJPEG
+    if ((ext == ".jpg" || ext == ".jpeg") && open_jpeg_rows(src, file))
+        return true;
+#endif
+    cout << "no streaming decoder for " << file << ", decoding the whole image" << endl;
+    src->whole = imread(file, IMREAD_GRAYSCALE);
+    src->size = src->whole.size();
+    return !src->whole.empty();
+}
+
+void open_synthetic_bands(band_source *src, const scene_params *scene)
+{
+    src->name = "synthetic";
+    src->scene = *scene;
+    src->size = scene->size;
+    src->next_row = 0;
+    src->pgm = NULL;
+    src->jpeg = NULL;
+    src->synthetic = true;
+    src->whole.release();
+}
+
+// fills all of dst (CV_8UC1, continuous or not) with the next dst.rows rows
+//  returns false if the image ends or a row can't be decoded
+bool read_rows(band_source *src, Mat &dst)
+{
+    if (src->next_row + dst.rows > src->size.height || dst.cols != src->size.width)
+        return false;
+    for (int r = 0; r < dst.rows; r++, src->next_row++) {
+        uchar *row = dst.ptr<uchar>(r);
+        if (src->pgm != NULL) {
+            if (fread(row, 1, dst.cols, src->pgm) != (size_t)dst.cols)
+                return false;
+        }
+#ifdef HAVE_LIBJPEG
+        else if (src->jpeg != NULL) {
+            if (!read_jpeg_row(src->jpeg, row))
+                return false;
+        }
+#endif
+        else if (src->synthetic)
+            render_scene_row(&src->scene, src->next_row, row);
+        else
+            memcpy(row, src->whole.ptr<uchar>(src->next_row), dst.cols);
+    }
+    return true;
+}
+
+void close_band_source(band_source *src)
+{
+    if (src->pgm != NULL)
+        fclose(src->pgm);
+#ifdef HAVE_LIBJPEG
+    if (src->jpeg != NULL) {
+        jpeg_destroy_decompress(&src->jpeg->cinfo);     // no finish: may stop before the last row
+        fclose(src->jpeg->f);
+        delete src->jpeg;
+    }
+#endif
+    src->pgm = NULL;
+    src->jpeg = NULL;
+    src->whole.release();
+}
@@ -0,0 +1,78 @@
+//
+//  source.h
+//  opencv
+//
+//  frame sources: a list of still images, a video file, a camera or a recording
+//  (recording.h), all delivered as grayscale frames one at a time
+
+#ifndef opencv_source_h
+#define opencv_source_h
+
+#include "project.h"
+#include "trace.h"
+#include "recording.h"
+#include "prefetch.h"
+#include "synth.h"
+#include "opencv2/videoio/videoio.hpp"
+#include <cstdio>
+
+// prefix of a source spec that selects a camera, e.g. "cam:0"
+#define CAMERA_PREFIX   "cam:"
+
+// reduced decoding: images can be decoded at 1/2, 1/4 or 1/8 size (JPEG: DCT scaling, no
+// full-size pass), and with libjpeg-turbo (-DHAVE_LIBJPEG) the rows above DECODE_ROI_TOP
+// are skipped without decoding them, since remove_skylines() throws those away anyway
+const double DECODE_ROI_TOP = 0.45;         // first decoded row, as a fraction of height
+
+struct frame_source {
+    string name;                            // spec the source was opened with (for printing)
+    vector<string> files;                   // still images, in order (if not video)
+    size_t next;                            // index of next image in files
+    bool video;                             // true if frames come from cap
+    VideoCapture cap;
+    Mat frame;                              // last decoded video frame, or image with colour set (BGR)
+    int scale;                              // 1, 2, 4 or 8: frames are decoded at 1/scale size (a
+                                            //  recording's are as recorded: see recorded_scale())
+    bool roi_only;                          // skip decoding the sky rows (JPEG + libjpeg only)
+    bool colour;                            // decode images in colour too, keeping them in frame
+    double decode_time;                     // total time spent reading/decoding frames (s)
+    prefetcher *prefetch;                   // reads the image files ahead (else NULL): decode_time is
+                                            //  then decoding only, and waiting for the reads is io_wait
+    double io_wait;                         // total time spent waiting for prefetched files (s)
+    double captured;                        // now() when the last frame was captured: after the video/camera
+                                            //  grab, or before reading the image file (start of its latency)
+    recording replay;                       // recording being replayed (replay.data NULL if none)
+    bool realtime;                          // replay at the recorded rate (default: as fast as possible)
+    double replay_start;                    // now() when the first recorded frame was delivered
+};
+
+// an image read a few rows at a time, for images too big to hold in memory
+//  streamed: binary PGM, JPEG (with -DHAVE_LIBJPEG) and synthetic scenes (synth.h);
+//  any other format is decoded whole once and handed out in rows (not memory-bounded)
+struct jpeg_rows;                           // libjpeg state (source.cpp)
+struct band_source {
+    string name;
+    Size size;                              // size of the whole image
+    int next_row;                           // first row the next read_rows() returns
+    FILE *pgm;                              // binary PGM, positioned at next_row (else NULL)
+    jpeg_rows *jpeg;                        // JPEG being decoded (else NULL)
+    bool synthetic;                         // rows are rendered from scene by render_scene_row()
+    scene_params scene;
+    Mat whole;                              // fallback: the whole decoded image
+};
+
+bool is_image_file(const string &);                         // true if the extension is a still image format
+bool open_source(frame_source *, const string &);           // camera ("cam:N"), recording (.lrec), video file or single image
+void close_source(frame_source *);                          // unmaps a recording (cameras/videos close themselves)
+void open_image_list(frame_source *, const vector<string> &);   // a sequence of still images
+bool next_frame(frame_source *, Mat &);                     // next grayscale frame, false at end
+Mat decode_image(const string &, int, bool, bool);          // grayscale/BGR image at 1/scale, optionally without sky rows (cached, if enabled)
+void to_luma(const Mat &, Mat &);                           // BGR frame to grayscale, into a reused buffer
+
+
+bool open_band_source(band_source *, const string &);      // false if the image can't be opened
+void open_synthetic_bands(band_source *, const scene_params *);     // a synthetic scene of any size
+bool read_rows(band_source *, Mat &);                      // next Mat::rows rows into a CV_8UC1 Mat, false at end
+void close_band_source(band_source *);
+
+#endif
@@ -0,0 +1,248 @@
+//
+//  streams.cpp
+//  opencv
+//
+
+#include "streams.h"
+#include <cstdio>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <cerrno>
+
+// ===================================================================
+// setting up streams
+// ===================================================================
+
+// opens a stream from a spec "source[@weight]" (weight defaults to 1)
+bool parse_stream(stream *s, int id, const string &spec, const lane_engine *engine, bool colour)
+{
+    string source = spec;
+    s->weight = 1;
+    size_t at = spec.rfind(WEIGHT_SEPARATOR);
+    if (at != string::npos) {
+        source = spec.substr(0, at);
+        s->weight = max(1, atoi(spec.c_str() + at + 1));
+    }
+    
+    s->id = id;
+    s->pass = 0;
+    s->busy = false;
+    s->done = false;
+    s->frames = s->skipped = 0;
+    s->first = s->last = 0;
+    s->latency_sum = s->latency_max = 0;
+    init_detector(&s->det, engine);
+    init_change_detector(&s->cd);
+    if (!open_source(&s->source, source))
+        return false;
+    s->source.colour = colour;
+    return true;
+}
+
+// ===================================================================
+// scheduling
+// ===================================================================
+
+// picks the runnable stream with the lowest pass (must hold pool->lock)
+//  returns NULL if every unfinished stream is busy; *finished set if all are done
+static stream *pick_stream(stream_pool *pool, bool *finished)
+{
+    stream *next = NULL;
+    *finished = true;
+    for (size_t i = 0; i < pool->streams.size(); i++) {
+        stream *s = pool->streams[i];
+        if (s->done)
+            continue;
+        *finished = false;
+        if (!s->busy && (next == NULL || s->pass < next->pass))
+            next = s;
+    }
+    return next;
+}
+
+// processes one frame of a stream (without holding the pool lock)
+//  returns false when the stream's source is exhausted
+static bool process_one(stream_pool *pool, stream *s)
+{
+    double start = now();
+    trace_frame(s->frames);
+    if (!next_frame(&s->source, s->frame))
+        return false;
+    if (s->frames == 0)
+        s->first = start;
+    
+    if (s->source.colour)
+        s->det.colour = s->source.frame;
+    if (!pool->skip_unchanged || frame_changed(&s->cd, s->frame))
+        run_detector(&s->det, s->frame);
+    else
+        s->skipped++;
+    
+    s->last = now();
+    double latency = s->last - start;
+    s->latency_sum += latency;
+    s->latency_max = max(s->latency_max, latency);
+    s->frames++;
+    return true;
+}
+
+struct worker_arg {
+    stream_pool *pool;
+    int index;                              // worker number (picks its core when pinned)
+};
+
+static void *worker(void *arg)
+{
+    stream_pool *pool = ((worker_arg *)arg)->pool;
+    if (pool->rt != NULL)
+        apply_thread_rt(pool->rt, ((worker_arg *)arg)->index);
+    
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        bool finished;
+        stream *s = pick_stream(pool, &finished);
+        if (finished)
+            break;
+        if (s == NULL) {
+            TRACE_BEGIN("queue wait");
+            pthread_cond_wait(&pool->idle, &pool->lock);
+            TRACE_END("queue wait");
+            continue;
+        }
+        // charge the stream for the frame up front, so other workers pick someone else
+        s->busy = true;
+        s->pass += STRIDE / s->weight;
+        pthread_mutex_unlock(&pool->lock);
+        
+        bool more = process_one(pool, s);
+        
+        pthread_mutex_lock(&pool->lock);
+        s->busy = false;
+        s->done = !more;
+        pthread_cond_broadcast(&pool->idle);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+// runs every stream until its source ends, on a pool of workers
+//  OpenCV's own threading is turned off: the pool already keeps every core busy,
+//  and nested thread pools (one per process, before) fight over the same cores
+int run_streams(stream_pool *pool, int workers)
+{
+    workers = max(1, min(workers, MAX_WORKERS));
+    setNumThreads(0);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->idle, NULL);
+    
+    if (pool->rt != NULL)
+        apply_process_rt(pool->rt);
+    
+    pthread_t threads[MAX_WORKERS];
+    worker_arg args[MAX_WORKERS];
+    int started = 0;
+    for (int i = 0; i < workers; i++) {
+        args[started].pool = pool;
+        args[started].index = pool->first_cpu + started;
+        if (pthread_create(&threads[started], NULL, worker, &args[started]) == 0)
+            started++;
+    }
+    if (started == 0) {
+        cout << "cannot start worker threads" << endl;
+        return -1;
+    }
+    for (int i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+    
+    pthread_cond_destroy(&pool->idle);
+    pthread_mutex_destroy(&pool->lock);
+    return 0;
+}
+
+// ===================================================================
+// results
+// ===================================================================
+
+void print_stream_stats(const stream_pool *pool, double elapsed)
+{
+    int total = 0;
+    cout << "stream  weight   frames  skipped       fps   latency avg (ms)   max (ms)   source" << endl;
+    for (size_t i = 0; i < pool->streams.size(); i++) {
+        const stream *s = pool->streams[i];
+        double span = s->last - s->first;
+        printf("%6d  %6d  %7d  %7d  %8.2f  %17.3f  %9.3f   %s\n", s->id, s->weight, s->frames,
+               s->skipped, span > 0 ? s->frames / span : 0.0,
+               s->frames ? 1000 * s->latency_sum / s->frames : 0.0, 1000 * s->latency_max,
+               s->source.name.c_str());
+        total += s->frames;
+    }
+    cout << "aggregate: " << total << " frames in " << elapsed << " s ("
+         << (elapsed > 0 ? total / elapsed : 0) << " fps)" << endl;
+}
+
+// ===================================================================
+// comparison: one process per stream
+// ===================================================================
+
+// child: runs one stream on its share of the workers, writes its frame count to the pipe
+static void run_child(const string &spec, int id, const lane_engine *engine, int workers,
+                      const stream_pool *settings, int fd)
+{
+    stream s;
+    stream_pool pool;
+    pool.skip_unchanged = settings->skip_unchanged;
+    pool.rt = settings->rt;
+    pool.colour = settings->colour;
+    pool.first_cpu = id * workers;          // next to the other processes' workers, as the shared
+                                            //  pool spreads its own (-c)
+    int frames = -1;
+    if (parse_stream(&s, id, spec, engine, pool.colour)) {
+        pool.streams.push_back(&s);
+        if (run_streams(&pool, workers) == 0)
+            frames = s.frames;
+    }
+    ssize_t written = write(fd, &frames, sizeof(frames));
+    _exit(written == sizeof(frames) ? 0 : 1);
+}
+
+int run_separate(const vector<string> &specs, const lane_engine *engine, int workers,
+                 const stream_pool *settings, double *elapsed)
+{
+    int n = (int)specs.size();
+    int share = max(1, workers / n);
+    vector<pid_t> children;
+    vector<int> pipes;
+    double start = now();
+    cout.flush();                           // (or the child's copy of the buffer is printed again)
+    for (int i = 0; i < n; i++) {
+        int fds[2];
+        if (pipe(fds) != 0)
+            break;
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(fds[0]);
+            run_child(specs[i], i, engine, share, settings, fds[1]);
+        }
+        close(fds[1]);
+        if (pid < 0) {
+            close(fds[0]);
+            break;
+        }
+        children.push_back(pid);
+        pipes.push_back(fds[0]);
+    }
+    
+    int total = (int)children.size() == n ? 0 : -1;
+    for (size_t i = 0; i < children.size(); i++) {
+        int frames = -1, status;
+        if (read(pipes[i], &frames, sizeof(frames)) != sizeof(frames) || frames < 0)
+            total = -1;
+        else if (total >= 0)
+            total += frames;
+        close(pipes[i]);
+        while (waitpid(children[i], &status, 0) < 0 && errno == EINTR)
+            ;
+    }
+    *elapsed = now() - start;
+    return total;
+}
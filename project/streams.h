@@ -0,0 +1,63 @@
+//
+//  streams.h
+//  opencv
+//
+//  several cameras (or videos) processed concurrently in one process:
+//  each stream has its own source and detector, all streams share one pool of
+//  worker threads, and a weighted fair (stride) scheduler picks which stream
+//  a free worker serves next
+
+#ifndef opencv_streams_h
+#define opencv_streams_h
+
+#include "engine.h"
+#include "source.h"
+#include "change.h"
+#include "rt.h"
+#include <pthread.h>
+
+// separates the source from its weight in a stream spec, e.g. "cam:0@4"
+#define WEIGHT_SEPARATOR    '@'
+
+const int MAX_WORKERS = 16;
+const double STRIDE = 1 << 16;              // stride scheduling: pass advances STRIDE/weight per frame
+
+struct stream {
+    int id;
+    frame_source source;
+    detector det;                           // per-stream detector state
+    change_detector cd;                     // per-stream change detection (-u)
+    int weight;                             // share of the workers relative to other streams
+    
+    // scheduling (guarded by the pool mutex)
+    double pass;                            // virtual time; lowest pass runs next
+    bool busy;                              // a worker is on this stream (frames stay in order)
+    bool done;                              // source exhausted
+    
+    // statistics (only touched by the worker that holds the stream)
+    Mat frame;
+    int frames, skipped;
+    double first, last;                     // wall time of first read, last result
+    double latency_sum, latency_max;        // read -> lane lines (s)
+};
+
+struct stream_pool {
+    vector<stream *> streams;
+    bool skip_unchanged;
+    const rt_config *rt;                    // pinning/scheduling of the workers (NULL = defaults)
+    int first_cpu;                          // worker k is pinned to rt's cpu first_cpu + k (in turn)
+    bool colour;                            // streams decode in colour too (-C, or the engine reads it)
+    pthread_mutex_t lock;
+    pthread_cond_t idle;                    // signalled when a stream stops being busy
+};
+
+bool parse_stream(stream *, int, const string &, const lane_engine *, bool);   // opens "source[@weight]",
+                                                                                //  in colour too if set
+int run_streams(stream_pool *, int);                        // runs all streams to the end on N workers
+void print_stream_stats(const stream_pool *, double);       // per-stream FPS/latency, aggregate FPS
+// runs the same streams the old way, each in its own process with 1/N of the workers:
+//  total frames (-1 if a process failed) and wall time until the last one ended (s)
+//  (settings: skip_unchanged, rt, colour as in this pool)
+int run_separate(const vector<string> &, const lane_engine *, int, const stream_pool *, double *);
+
+#endif
@@ -0,0 +1,255 @@
+//
+//  synth.cpp
+//  opencv
+//
+
+#include "synth.h"
+#include <fstream>
+#include <sstream>
+
+// colours (BGR)
+const Vec3b SKY (200, 170, 140);
+const Vec3b ROADSIDE (70, 110, 90);
+const Vec3b ASPHALT (90, 90, 90);
+const Vec3b WHITE_PAINT (235, 235, 235);
+const Vec3b YELLOW_PAINT (40, 200, 230);
+const double SHOULDER = 0.03;               // asphalt past the outer lines (fraction of road width)
+
+void init_scene_params(scene_params *p)
+{
+    p->size = Size(1280, 720);
+    p->lanes = 2;
+    p->curve = 0;
+    p->dashed = true;
+    p->shadows = 0;
+    p->noise = 0;
+    p->clutter = 0;
+    p->seed = 1;
+    p->count = 1;
+}
+
+// "WxH" followed by any of ",lanes=N", ",curve=F", ",dashed=0|1", ",shadows=N",
+// ",noise=F", ",clutter=N", ",seed=N", ",count=N"; unspecified keys keep their value
+bool parse_scene(const char *spec, scene_params *p)
+{
+    stringstream ss(spec);
+    string item;
+    getline(ss, item, ',');
+    int w, h;
+    if (sscanf(item.c_str(), "%dx%d", &w, &h) != 2 || w <= 0 || h <= 0)
+        return false;
+    p->size = Size(w, h);
+    
+    while (getline(ss, item, ',')) {
+        size_t eq = item.find('=');
+        if (eq == string::npos)
+            return false;
+        string key = item.substr(0, eq);
+        const char *value = item.c_str() + eq + 1;
+        if (key == "lanes")
+            p->lanes = max(1, atoi(value));
+        else if (key == "curve")
+            p->curve = atof(value);
+        else if (key == "dashed")
+            p->dashed = atoi(value) != 0;
+        else if (key == "shadows")
+            p->shadows = atoi(value);
+        else if (key == "noise")
+            p->noise = atof(value);
+        else if (key == "clutter")
+            p->clutter = atoi(value);
+        else if (key == "seed")
+            p->seed = (unsigned)atoi(value);
+        else if (key == "count")
+            p->count = max(1, atoi(value));
+        else
+            return false;
+    }
+    return true;
+}
+
+// ===================================================================
+// rendering
+// ===================================================================
+
+// image x of a point across the road at a depth
+//  u: -0.5 = left edge of the road, 0.5 = right edge
+//  t: 0 = horizon, 1 = bottom row (the road narrows linearly to the vanishing point,
+//     and bends sideways by curve*width at the horizon)
+static double road_x(const scene_params *p, double u, double t)
+{
+    double w = p->size.width;
+    return w/2 + u * SYNTH_ROAD_WIDTH * w * t + p->curve * w * (1-t) * (1-t);
+}
+
+// paints columns [x0, x1) of a row, clipped to the image
+template <class T>
+static void fill_span(T *row, double x0, double x1, int width, T colour)
+{
+    for (int x = max(0, (int)round(x0)); x < min(width, (int)round(x1)); x++)
+        row[x] = colour;
+}
+
+// luma of a colour, as cvtColor's BGR2GRAY computes it
+static uchar gray(Vec3b c)
+{
+    return saturate_cast<uchar>(0.114 * c[0] + 0.587 * c[1] + 0.299 * c[2]);
+}
+
+// paints row y of the scene without shadows, clutter and noise (those are drawn over the
+// whole frame): sky above the horizon; roadside, asphalt and markings below it
+//  T is Vec3b (BGR) or uchar (gray); the colours are given in T: sky, roadside, asphalt,
+//  white and yellow paint
+template <class T>
+static void paint_row(const scene_params *p, int y, T *row, const T colours[5])
+{
+    int w = p->size.width, h = p->size.height;
+    int horizon = (int)(h * SYNTH_HORIZON);
+    if (y < horizon) {
+        fill_span(row, 0, w, w, colours[0]);
+        return;
+    }
+    double t = (double)(y - horizon) / max(1, h - 1 - horizon);
+    fill_span(row, 0, w, w, colours[1]);
+    fill_span(row, road_x(p, -0.5 - SHOULDER, t), road_x(p, 0.5 + SHOULDER, t), w, colours[2]);
+    
+    double half = max(0.5, SYNTH_LINE_WIDTH * w * t / 2);
+    bool dash_on = fmod(SYNTH_DASH_FREQ / max(t, 1e-3), 1.0) < 0.5;
+    for (int i = 0; i <= p->lanes; i++) {
+        bool centre = p->lanes % 2 == 0 && i == p->lanes / 2;
+        bool inner = i > 0 && i < p->lanes;
+        if (p->dashed && inner && !centre && !dash_on)
+            continue;
+        double x = road_x(p, -0.5 + (double)i / p->lanes, t);
+        fill_span(row, x - half, x + half, w, centre ? colours[4] : colours[3]);
+    }
+}
+
+void render_scene_row(const scene_params *p, int y, uchar *row)
+{
+    const uchar colours[5] = { gray(SKY), gray(ROADSIDE), gray(ASPHALT), gray(WHITE_PAINT), gray(YELLOW_PAINT) };
+    paint_row(p, y, row, colours);
+}
+
+Vec4i scene_line(const scene_params *p, int i)
+{
+    int h = p->size.height;
+    int horizon = (int)(h * SYNTH_HORIZON);
+    int y_top = horizon + (int)(SYNTH_TRUTH_TOP * (h - 1 - horizon));
+    double u = -0.5 + (double)i / p->lanes;
+    return Vec4i((int)round(road_x(p, u, 1)), h-1, (int)round(road_x(p, u, SYNTH_TRUTH_TOP)), y_top);
+}
+
+Mat render_scene(const scene_params *p, vector<Vec4i> *truth)
+{
+    int w = p->size.width, h = p->size.height;
+    int horizon = (int)(h * SYNTH_HORIZON);
+    RNG rng(p->seed);
+    Mat img(p->size, CV_8UC3);
+    
+    img.rowRange(0, horizon).setTo(Scalar(SKY[0], SKY[1], SKY[2]));
+    const Vec3b colours[5] = { SKY, ROADSIDE, ASPHALT, WHITE_PAINT, YELLOW_PAINT };
+    for (int y = horizon; y < h; y++)
+        paint_row(p, y, img.ptr<Vec3b>(y), colours);
+    
+    // shadows: darker bands across the road, at a random depth and angle
+    for (int s = 0; s < p->shadows; s++) {
+        int y0 = rng.uniform(horizon + (h-horizon)/5, h - 1);
+        int thickness = rng.uniform(h/40 + 1, h/10 + 2);
+        int skew = rng.uniform(-h/10, h/10 + 1);
+        Point pts[4] = { Point(0, y0), Point(w-1, y0+skew), Point(w-1, y0+skew+thickness), Point(0, y0+thickness) };
+        Mat mask = Mat::zeros(p->size, CV_8UC1);
+        fillConvexPoly(mask, pts, 4, Scalar(255));
+        Mat dark;
+        img.convertTo(dark, -1, 0.5);
+        dark.copyTo(img, mask);
+    }
+    
+    // clutter: short bright/dark strokes below the horizon (cars, rails, cracks)
+    int stroke = max(1, w / 400);
+    for (int c = 0; c < p->clutter; c++) {
+        Point a(rng.uniform(0, w), rng.uniform(horizon, h));
+        Point b(a.x + rng.uniform(-w/8, w/8 + 1), a.y + rng.uniform(-h/10, h/10 + 1));
+        int v = rng.uniform(0, 2) ? rng.uniform(170, 256) : rng.uniform(0, 40);
+        line(img, a, b, Scalar(v, v, v), stroke, LINE_TYPE);
+    }
+    
+    if (p->noise > 0) {
+        Mat noise(p->size, CV_16SC3), tmp;
+        rng.fill(noise, RNG::NORMAL, Scalar::all(0), Scalar::all(p->noise));
+        img.convertTo(tmp, CV_16SC3);
+        tmp += noise;
+        tmp.convertTo(img, CV_8UC3);
+    }
+    
+    // ground truth: each line's chord from the bottom row to depth SYNTH_TRUTH_TOP
+    if (truth != NULL) {
+        truth->clear();
+        for (int i = 0; i <= p->lanes; i++)
+            truth->push_back(scene_line(p, i));
+    }
+    return img;
+}
+
+// writes dir/synth_NNNN.png and its ground truth dir/synth_NNNN.txt for each frame
+//  frame k is rendered with seed + k; returns -1 if a file can't be written
+int generate_scenes(const scene_params *p, const char *dir)
+{
+    for (int k = 0; k < p->count; k++) {
+        scene_params frame = *p;
+        frame.seed = p->seed + k;
+        vector<Vec4i> truth;
+        Mat img = render_scene(&frame, &truth);
+        
+        char name[256];
+        snprintf(name, sizeof(name), "%s/synth_%04d.png", dir, k);
+        if (!imwrite(name, img)) {
+            cout << "cannot write " << name << endl;
+            return -1;
+        }
+        ofstream out(truth_file(name).c_str());
+        out << "# " << p->size.width << "x" << p->size.height << " lanes=" << p->lanes << " curve=" << p->curve
+            << " dashed=" << p->dashed << " shadows=" << p->shadows << " noise=" << p->noise
+            << " clutter=" << p->clutter << " seed=" << frame.seed << endl;
+        out << "# x1 y1 x2 y2 (bottom row, then up the road), left to right" << endl;
+        for (size_t i = 0; i < truth.size(); i++)
+            out << truth[i][X1] << " " << truth[i][Y1] << " " << truth[i][X2] << " " << truth[i][Y2] << endl;
+        if (!out) {
+            cout << "cannot write " << truth_file(name) << endl;
+            return -1;
+        }
+    }
+    cout << "wrote " << p->count << " frame(s) to " << dir << "/synth_*.png" << endl;
+    return 0;
+}
+
+// ===================================================================
+// ground truth
+// ===================================================================
+
+string truth_file(const string &image)
+{
+    size_t dot = image.rfind('.');
+    size_t slash = image.rfind('/');
+    if (dot == string::npos || (slash != string::npos && dot < slash))
+        return image + ".txt";
+    return image.substr(0, dot) + ".txt";
+}
+
+// one line per row, "x1 y1 x2 y2"; '#' starts a comment line
+bool read_truth(const string &file, vector<Vec4i> *lines)
+{
+    ifstream in(file.c_str());
+    if (!in)
+        return false;
+    lines->clear();
+    string text;
+    while (getline(in, text)) {
+        if (text.empty() || text[0] == '#')
+            continue;
+        Vec4i l;
+        if (sscanf(text.c_str(), "%d %d %d %d", &l[X1], &l[Y1], &l[X2], &l[Y2]) == 4)
+            lines->push_back(l);
+    }
+    return true;
+}
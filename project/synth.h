@@ -0,0 +1,49 @@
+//
+//  synth.h
+//  opencv
+//
+//  synthetic road scenes with known lane lines: a straight or curving road seen from
+//  the car, with solid/dashed markings, shadows, clutter and noise, at any resolution,
+//  so benchmarks can sweep frame size and segment count, and accuracy can be measured
+//  against ground truth instead of against the reference engine
+
+#ifndef opencv_synth_h
+#define opencv_synth_h
+
+#include "project.h"
+
+// ---
+// scene layout, as fractions of height/width
+// ---
+const double SYNTH_HORIZON = 0.55;          // row of the horizon (vanishing point)
+const double SYNTH_ROAD_WIDTH = 0.80;       // width of the road at the bottom row
+const double SYNTH_LINE_WIDTH = 0.006;      // width of a painted line at the bottom row
+const double SYNTH_DASH_FREQ = 4.0;         // dashes per unit of (1/depth); higher = shorter dashes
+const double SYNTH_TRUTH_TOP = 0.5;         // ground-truth lines run from the bottom row up to this
+                                            //  depth (0 = horizon, 1 = bottom row)
+
+// what a scene looks like; parse_scene() reads these from "WxH,key=value,..."
+struct scene_params {
+    Size size;
+    int lanes;                              // lanes on the road (lanes+1 lines; the centre one is yellow if even)
+    double curve;                           // sideways bend at the horizon, as a fraction of width (0 = straight)
+    bool dashed;                            // inner lines dashed (outer lines are always solid)
+    int shadows;                            // shadows across the road
+    double noise;                           // standard deviation of pixel noise (gray levels)
+    int clutter;                            // random roadside edges (cars, rails) to feed HoughLinesP
+    unsigned seed;
+    int count;                              // frames to generate (seed, seed+1, ...)
+};
+
+void init_scene_params(scene_params *);
+bool parse_scene(const char *, scene_params *);             // false on an unknown key
+Mat render_scene(const scene_params *, vector<Vec4i> *);    // BGR frame, ground-truth lane lines (left to right)
+void render_scene_row(const scene_params *, int, uchar *);  // row y in gray, without shadows, clutter and noise
+                                                            //  (frames too big to render whole: band sources)
+Vec4i scene_line(const scene_params *, int);                // ground truth of lane line i (0..lanes)
+int generate_scenes(const scene_params *, const char *);    // writes count frames + ground truth to a directory
+
+string truth_file(const string &);                          // ground-truth file of an image (same name, .txt)
+bool read_truth(const string &, vector<Vec4i> *);           // false if there is no ground truth
+
+#endif
@@ -0,0 +1,194 @@
+//
+//  telemetry.cpp
+//  opencv
+//
+
+#include "telemetry.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// reads a number from a sysfs file kept open (from the start, so the value is fresh)
+static bool read_value(int fd, long long *value, int base)
+{
+    char buf[64];
+    ssize_t n = fd >= 0 ? pread(fd, buf, sizeof(buf) - 1, 0) : -1;
+    if (n <= 0)
+        return false;
+    buf[n] = 0;
+    char *end;
+    *value = strtoll(buf, &end, base);
+    return end != buf;
+}
+
+// opens a sysfs file and checks that it can be read (-1 if not); base 16 takes the Pi's
+// hex flags as well as decimal values
+static int open_value(const char *path)
+{
+    long long value;
+    int fd = open(path, O_RDONLY);
+    if (fd >= 0 && !read_value(fd, &value, 16)) {
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+// the thermal zone of the cpu or package (by type), else the first one
+static int open_thermal_zone()
+{
+    const char *types[] = { "x86_pkg_temp", "cpu-thermal", "cpu_thermal", "soc_thermal", "cpu" };
+    int best = -1, best_rank = sizeof(types) / sizeof(types[0]);
+    for (int i = 0; i < TELEMETRY_MAX_ZONES; i++) {
+        char path[96], type[64] = "";
+        snprintf(path, sizeof(path), "/sys/class/thermal/thermal_zone%d/type", i);
+        FILE *f = fopen(path, "r");
+        if (f == NULL)
+            break;
+        bool ok = fscanf(f, "%63s", type) == 1;
+        fclose(f);
+        for (int r = 0; ok && r < best_rank; r++)
+            if (strncmp(type, types[r], strlen(types[r])) == 0) {
+                best = i;
+                best_rank = r;
+            }
+        if (best < 0)
+            best = i;
+    }
+    if (best < 0)
+        return -1;
+    char path[96];
+    snprintf(path, sizeof(path), "/sys/class/thermal/thermal_zone%d/temp", best);
+    return open_value(path);
+}
+
+bool open_telemetry(telemetry *t)
+{
+    int cpus = (int)sysconf(_SC_NPROCESSORS_CONF);
+    t->freq_fds.assign(max(cpus, 1), -1);
+    bool freq = false;
+    for (int i = 0; i < cpus; i++) {
+        char path[96];
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_cur_freq", i);
+        t->freq_fds[i] = open_value(path);
+        freq = freq || t->freq_fds[i] >= 0;
+    }
+    t->temp_fd = open_thermal_zone();
+    
+    // Raspberry Pi: the firmware's flags; x86: a count of package throttling events
+    t->throttle_flags = true;
+    t->throttle_fd = open_value("/sys/devices/platform/soc/soc:firmware/get_throttled");
+    if (t->throttle_fd < 0) {
+        t->throttle_flags = false;
+        t->throttle_fd = open_value("/sys/devices/system/cpu/cpu0/thermal_throttle/package_throttle_count");
+    }
+    t->throttle_count = 0;
+    if (!t->throttle_flags)
+        read_value(t->throttle_fd, &t->throttle_count, 10);
+    
+    t->rapl_fds.clear();
+    t->rapl_range.clear();
+    t->rapl_last.clear();
+    for (int i = 0; i < TELEMETRY_MAX_PACKAGES; i++) {
+        char path[96];
+        long long value, range;
+        snprintf(path, sizeof(path), "/sys/class/powercap/intel-rapl:%d/max_energy_range_uj", i);
+        int range_fd = open_value(path);
+        bool ok = read_value(range_fd, &range, 10);
+        if (range_fd >= 0)
+            close(range_fd);
+        snprintf(path, sizeof(path), "/sys/class/powercap/intel-rapl:%d/energy_uj", i);
+        int fd = ok ? open_value(path) : -1;
+        if (fd < 0)
+            continue;
+        read_value(fd, &value, 10);
+        t->rapl_fds.push_back(fd);
+        t->rapl_range.push_back((double)range);
+        t->rapl_last.push_back((double)value);
+    }
+    
+    t->start = t->last = now();
+    t->samples = t->mhz_samples = t->throttled = 0;
+    t->mhz_sum = t->joules = 0;
+    t->temp_max = -1;
+    
+    cout << "telemetry:  clock " << (freq ? "yes" : "no") << ", temperature " << (t->temp_fd >= 0 ? "yes" : "no")
+         << ", throttling " << (t->throttle_fd >= 0 ? "yes" : "no") << ", energy "
+         << (t->rapl_fds.empty() ? "no" : "yes") << endl;
+    return freq || t->temp_fd >= 0 || t->throttle_fd >= 0 || !t->rapl_fds.empty();
+}
+
+void sample_telemetry(telemetry *t, telemetry_sample *s)
+{
+    long long value;
+    int cpu = sched_getcpu();
+    s->mhz = -1;
+    if (cpu >= 0 && cpu < (int)t->freq_fds.size() && read_value(t->freq_fds[cpu], &value, 10))
+        s->mhz = value / 1000.0;        // kHz
+    s->temp = read_value(t->temp_fd, &value, 10) ? value / 1000.0 : -1;    // millidegrees
+    
+    s->throttled = -1;
+    if (t->throttle_flags && read_value(t->throttle_fd, &value, 16))
+        s->throttled = (value & PI_THROTTLED) != 0;
+    else if (!t->throttle_flags && read_value(t->throttle_fd, &value, 10)) {
+        s->throttled = value != t->throttle_count;
+        t->throttle_count = value;
+    }
+    
+    // counters wrap at max_energy_range_uj
+    s->joules = t->rapl_fds.empty() ? -1 : 0;
+    for (size_t i = 0; i < t->rapl_fds.size(); i++) {
+        if (!read_value(t->rapl_fds[i], &value, 10))
+            continue;
+        double uj = value - t->rapl_last[i];
+        if (uj < 0)
+            uj += t->rapl_range[i];
+        s->joules += uj * 1e-6;
+        t->rapl_last[i] = (double)value;
+    }
+    t->last = now();
+    
+    t->samples++;
+    if (s->mhz >= 0) {
+        t->mhz_sum += s->mhz;
+        t->mhz_samples++;
+    }
+    t->temp_max = max(t->temp_max, s->temp);
+    t->throttled += s->throttled > 0;
+    if (s->joules >= 0)
+        t->joules += s->joules;
+}
+
+void print_telemetry(const telemetry *t, int frames)
+{
+    if (t->samples == 0)
+        return;
+    if (t->mhz_samples > 0)
+        cout << "clock:      " << t->mhz_sum / t->mhz_samples << " MHz avg" << endl;
+    if (t->temp_max >= 0)
+        cout << "temperature: " << t->temp_max << " C max" << endl;
+    if (t->throttle_fd >= 0)
+        cout << "throttled:  " << t->throttled << " of " << t->samples << " frames" << endl;
+    if (!t->rapl_fds.empty() && t->joules > 0)
+        cout << "energy:     " << t->joules / frames << " J per frame, " << frames / t->joules
+             << " frames per J (" << t->joules / (t->last - t->start) << " W avg)" << endl;
+}
+
+void close_telemetry(telemetry *t)
+{
+    for (size_t i = 0; i < t->freq_fds.size(); i++)
+        if (t->freq_fds[i] >= 0)
+            close(t->freq_fds[i]);
+    for (size_t i = 0; i < t->rapl_fds.size(); i++)
+        close(t->rapl_fds[i]);
+    if (t->temp_fd >= 0)
+        close(t->temp_fd);
+    if (t->throttle_fd >= 0)
+        close(t->throttle_fd);
+    t->freq_fds.clear();
+    t->rapl_fds.clear();
+    t->temp_fd = t->throttle_fd = -1;
+}
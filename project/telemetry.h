@@ -0,0 +1,51 @@
+//
+//  telemetry.h
+//  opencv
+//
+//  per-frame machine state to go with the stage times: the clock of the cpu the frame ran
+//  on, the SoC/package temperature, whether the cpu was throttled, and the energy the
+//  package used (RAPL), all read from sysfs - so a slow frame can be put down to the code
+//  or to the chip, and configurations compared in frames per joule
+//
+//  every reading is optional: what a machine doesn't have (no cpufreq in a VM, no RAPL on
+//  ARM, energy_uj readable only by root on recent kernels) is left out, not an error; the
+//  files are opened once and re-read with pread(), so a sample is a few small reads
+
+#ifndef opencv_telemetry_h
+#define opencv_telemetry_h
+
+#include "project.h"
+
+const int TELEMETRY_MAX_ZONES = 32;         // thermal zones looked at for the cpu's
+const int TELEMETRY_MAX_PACKAGES = 8;       // RAPL packages summed
+const int PI_THROTTLED = 0xe;               // get_throttled bits: arm clock capped, throttled, soft
+                                            //  temperature limit (bit 0, under-voltage, is left out)
+
+struct telemetry_sample {
+    double mhz;                             // clock of the cpu taking the sample (-1 if unknown)
+    double temp;                            // degrees C (-1 if unknown)
+    int throttled;                          // 1 if throttled since the last sample, 0 if not, -1 if unknown
+    double joules;                          // package energy since the last sample (-1 if unknown)
+};
+
+struct telemetry {
+    vector<int> freq_fds;                   // scaling_cur_freq of each cpu (-1 if none)
+    int temp_fd;                            // temp of the cpu/package thermal zone (-1 if none)
+    int throttle_fd;                        // Pi firmware get_throttled, else cpu0's package_throttle_count
+    bool throttle_flags;                    // throttle_fd is the Pi's bit mask (else a count)
+    long long throttle_count;               // count at the last sample
+    vector<int> rapl_fds;                   // energy_uj of each package
+    vector<double> rapl_range;              // max_energy_range_uj (the counter wraps there)
+    vector<double> rapl_last;               // energy_uj at the last sample
+    double start, last;                     // now() when opened / at the last sample
+    // totals of the samples so far
+    int samples, mhz_samples, throttled;
+    double mhz_sum, temp_max, joules;
+};
+
+bool open_telemetry(telemetry *);           // finds the readings this machine has; false if none
+void sample_telemetry(telemetry *, telemetry_sample *);    // current readings (energy: since the last call)
+void print_telemetry(const telemetry *, int);              // averages over the samples, frames per joule
+void close_telemetry(telemetry *);
+
+#endif
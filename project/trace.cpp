@@ -0,0 +1,96 @@
+//
+//  trace.cpp
+//  opencv
+//
+
+#include "trace.h"
+#include <cstdio>
+
+bool trace_enabled = false;
+
+static trace_buffer *buffers[TRACE_MAX_THREADS];    // one per thread that recorded something
+static int num_buffers = 0;
+static double trace_start;                          // time 0 of the trace
+
+static __thread trace_buffer *local_buffer = NULL;
+static __thread int local_frame = 0;
+
+void start_trace()
+{
+    trace_start = now();
+    trace_enabled = true;
+}
+
+// first event of a thread: claims a slot with an atomic increment (no lock)
+static trace_buffer *thread_buffer()
+{
+    if (local_buffer == NULL) {
+        int slot = __sync_fetch_and_add(&num_buffers, 1);
+        if (slot >= TRACE_MAX_THREADS)
+            return NULL;
+        trace_buffer *buf = new trace_buffer;
+        buf->tid = slot;
+        buf->count = 0;
+        buf->dropped = 0;
+        buffers[slot] = buf;
+        local_buffer = buf;
+    }
+    return local_buffer;
+}
+
+void trace_event_record(const char *name, char phase)
+{
+    trace_buffer *buf = thread_buffer();
+    if (buf == NULL)
+        return;
+    if (buf->count == TRACE_CAPACITY) {
+        buf->dropped++;
+        return;
+    }
+    trace_event *e = &buf->events[buf->count];
+    e->name = name;
+    e->ts = now();
+    e->frame = local_frame;
+    e->phase = phase;
+    buf->count++;
+}
+
+void trace_frame(int frame)
+{
+    local_frame = frame;
+}
+
+// writes {"traceEvents": [...]} with timestamps in microseconds
+//  call once the traced threads have finished
+bool write_trace(const char *filename)
+{
+    FILE *out = fopen(filename, "w");
+    if (out == NULL) {
+        cout << "cannot write trace to " << filename << endl;
+        return false;
+    }
+    
+    int threads = min(num_buffers, TRACE_MAX_THREADS);
+    int events = 0, dropped = 0;
+    bool first = true;
+    fprintf(out, "{\"traceEvents\":[\n");
+    for (int t = 0; t < threads; t++) {
+        trace_buffer *buf = buffers[t];
+        for (int i = 0; i < buf->count; i++) {
+            trace_event *e = &buf->events[i];
+            fprintf(out, "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%d,\"args\":{\"frame\":%d}}",
+                    first ? "" : ",\n", e->name, e->phase, (e->ts - trace_start) * 1e6, buf->tid, e->frame);
+            first = false;
+        }
+        events += buf->count;
+        dropped += buf->dropped;
+    }
+    fprintf(out, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    fclose(out);
+    
+    cout << "trace: " << events << " events from " << threads << " thread(s) written to " << filename;
+    if (dropped)
+        cout << " (" << dropped << " dropped, buffer full)";
+    cout << endl;
+    return true;
+}
@@ -0,0 +1,49 @@
+//
+//  trace.h
+//  opencv
+//
+//  per-frame timeline tracing, dumped as Chrome trace-event JSON
+//  (open in chrome://tracing or ui.perfetto.dev)
+//
+//  every thread records begin/end events into its own fixed-size buffer, so
+//  recording takes no locks; when tracing is off each TRACE_* macro is one
+//  well-predicted branch, and building with -DNO_TRACE removes them entirely
+
+#ifndef opencv_trace_h
+#define opencv_trace_h
+
+#include "project.h"
+
+const int TRACE_CAPACITY = 1 << 16;         // events per thread (later events are dropped)
+const int TRACE_MAX_THREADS = 32;           // threads that can record events
+
+struct trace_event {
+    const char *name;                       // must be a string literal (not copied)
+    double ts;                              // time (in s, from now())
+    int frame;                              // frame being processed by the thread
+    char phase;                             // 'B' = begin, 'E' = end
+};
+
+struct trace_buffer {
+    int tid;
+    int count;
+    int dropped;
+    trace_event events[TRACE_CAPACITY];
+};
+
+extern bool trace_enabled;
+
+void start_trace();                         // turns recording on
+void trace_event_record(const char *, char);    // adds an event to the calling thread's buffer
+void trace_frame(int);                      // sets the frame number for the calling thread's events
+bool write_trace(const char *);             // writes all threads' events as JSON
+
+#ifdef NO_TRACE
+#define TRACE_BEGIN(name)
+#define TRACE_END(name)
+#else
+#define TRACE_BEGIN(name)   do { if (trace_enabled) trace_event_record(name, 'B'); } while (0)
+#define TRACE_END(name)     do { if (trace_enabled) trace_event_record(name, 'E'); } while (0)
+#endif
+
+#endif
@@ -0,0 +1,125 @@
+//
+//  vanish.cpp
+//  opencv
+//
+
+#include "vanish.h"
+
+// a segment's line as a x + b y + c = 0 with (a,b) of unit length, so |a x + b y + c|
+// is the distance of (x,y) from the line
+static Vec3d normal_form(Vec4i l)
+{
+    double a = l[Y2] - l[Y1], b = l[X1] - l[X2];
+    double n = sqrt(a*a + b*b);
+    return Vec3d(a / n, b / n, -(a * l[X1] + b * l[Y1]) / n);
+}
+
+static double line_distance(Vec3d line, Point2d p)
+{
+    return abs(line[0] * p.x + line[1] * p.y + line[2]);
+}
+
+// total length of the segments whose lines pass within tol of p
+static double support(const vector<Vec3d> &lines, const vector<double> &length, Point2d p, double tol)
+{
+    double sum = 0;
+    for (size_t i = 0; i < lines.size(); i++)
+        if (line_distance(lines[i], p) <= tol)
+            sum += length[i];
+    return sum;
+}
+
+// least-squares point closest to the supporting lines (weighted by length): solves
+// (sum w n n^T) p = -(sum w c n); keeps p if the lines are (nearly) parallel
+static Point2d refine(const vector<Vec3d> &lines, const vector<double> &length, Point2d p, double tol)
+{
+    double sxx = 0, sxy = 0, syy = 0, bx = 0, by = 0;
+    for (size_t i = 0; i < lines.size(); i++) {
+        if (line_distance(lines[i], p) > tol)
+            continue;
+        double w = length[i], a = lines[i][0], b = lines[i][1], c = lines[i][2];
+        sxx += w*a*a;
+        sxy += w*a*b;
+        syy += w*b*b;
+        bx -= w*a*c;
+        by -= w*b*c;
+    }
+    double det = sxx*syy - sxy*sxy;
+    if (abs(det) < 1e-9 * max(sxx*syy, 1.0))
+        return p;
+    return Point2d((bx*syy - by*sxy) / det, (by*sxx - bx*sxy) / det);
+}
+
+// ------------------------
+
+void init_vanishing_point(vanishing_point *vp)
+{
+    vp->found = false;
+    vp->reused = false;
+}
+
+// the point most segment length points at: if last frame's point still has VP_REUSE of
+// the support it is only refined; otherwise up to VP_ITERATIONS random pairs of segments
+// are intersected and the candidate with the most support wins (last frame's point
+// competes too), then refined
+//  candidates must lie above the bottom row and within a frame width either side; a
+//  point needs VP_MIN_SUPPORT of the total length, else vp->found is cleared
+bool find_vanishing_point(const vector<Vec4i> &segments, Size size, vanishing_point *vp)
+{
+    int n = (int)segments.size();
+    vector<Vec3d> lines(n);
+    vector<double> length(n);
+    double total = 0;
+    for (int i = 0; i < n; i++) {
+        lines[i] = normal_form(segments[i]);
+        length[i] = norm(Point(segments[i][X2] - segments[i][X1], segments[i][Y2] - segments[i][Y1]));
+        total += length[i];
+    }
+    double tol = VP_TOLERANCE * size.width;
+    
+    Point2d best;
+    double best_support = 0;
+    vp->reused = false;
+    if (vp->found) {
+        best = vp->at;
+        best_support = support(lines, length, best, tol);
+        vp->reused = best_support >= VP_REUSE * total;
+    }
+    
+    RNG rng(VP_SEED);
+    for (int k = 0; k < VP_ITERATIONS && !vp->reused && n >= 2; k++) {
+        int i = rng.uniform(0, n), j = rng.uniform(0, n - 1);
+        if (j >= i)
+            j++;
+        Vec3d a = lines[i], b = lines[j];
+        double d = a[0]*b[1] - a[1]*b[0];
+        if (abs(d) < 1e-6)                  // parallel
+            continue;
+        Point2d p((a[1]*b[2] - a[2]*b[1]) / d, (a[2]*b[0] - a[0]*b[2]) / d);
+        if (p.y > size.height || p.x < -size.width || p.x > 2 * size.width)
+            continue;
+        double s = support(lines, length, p, tol);
+        if (s > best_support) {
+            best = p;
+            best_support = s;
+        }
+    }
+    
+    vp->found = n >= 2 && best_support >= VP_MIN_SUPPORT * total;
+    if (vp->found)
+        vp->at = refine(lines, length, best, tol);
+    return vp->found;
+}
+
+void remove_outliers(vector<Vec4i> *segments, const vanishing_point *vp, Size size)
+{
+    double tol = VP_TOLERANCE * size.width;
+    for (size_t i = 0; i < segments->size(); i++)
+        if (!points_at((*segments)[i], vp->at, tol))
+            segments->erase(segments->begin() + i--);
+}
+
+bool points_at(Vec4i l, Point2d p, double tol)
+{
+    return line_distance(normal_form(l), p) <= tol;
+}
@@ -0,0 +1,33 @@
+//
+//  vanish.h
+//  opencv
+//
+//  vanishing point of the road: lane lines all point at it, so segments whose extension
+//  misses it are clutter and can be dropped before the pairwise merge of combine_lines()
+
+#ifndef opencv_vanish_h
+#define opencv_vanish_h
+
+#include "project.h"
+
+const int VP_ITERATIONS = 64;               // RANSAC samples (segment pairs) per frame, at most
+const uint64 VP_SEED = 0x5eed;              // same samples every run, so results are repeatable
+const double VP_TOLERANCE = 0.04;           // how far (fraction of width) a segment's extension may miss the point
+const double VP_REUSE = 0.80;               // last frame's point is kept, without sampling, if segments
+                                            //  this long (fraction of total length) still point at it
+const double VP_MIN_SUPPORT = 0.30;         // fraction of total segment length that must point at a
+                                            //  candidate for it to be used at all
+
+// estimate kept between the frames of a stream
+struct vanishing_point {
+    Point2d at;                             // position (may lie outside the frame)
+    bool found;                             // false: no estimate yet, or the last frame had none
+    bool reused;                            // last frame kept the previous estimate (no sampling)
+};
+
+void init_vanishing_point(vanishing_point *);
+bool find_vanishing_point(const vector<Vec4i> &, Size, vanishing_point *);      // RANSAC, seeded with the last estimate
+void remove_outliers(vector<Vec4i> *, const vanishing_point *, Size);           // drops segments that miss the point
+bool points_at(Vec4i, Point2d, double);     // true if the line through a segment passes within tol px of a point
+
+#endif